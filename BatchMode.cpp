@@ -0,0 +1,344 @@
+#include "BatchMode.h"
+#include "MatrixArena.h"
+#include "MatrixFile.h"
+#include "SparseMatrix.h"
+#include "Statistics.h"
+#include "ThreadPool.h"
+#include <charconv>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+
+// Jobs read from the stream before a chunk is executed
+static const int BATCH_CHUNK = 1024;
+
+// rref operands with at least this many elements, and at most this many
+// nonzeros per row on average, are eliminated as a SparseMatrix. Fill-in
+// makes sparse elimination slower than dense beyond about 10 per row
+// (see benchmark sparse).
+static const long long SPARSE_RREF_MIN_ELEMENTS = 64 * 64;
+static const int SPARSE_RREF_MAX_ROW_NONZEROS = 8;
+
+struct OpEntry {
+  const char *name;
+  BatchOp op;
+  int arity;
+};
+
+static const OpEntry OPS[] = {
+    {"add", BatchOp::Add, 2},
+    {"sub", BatchOp::Subtract, 2},
+    {"mul", BatchOp::Multiply, 2},
+    {"solve", BatchOp::Solve, 2},
+    {"det", BatchOp::Determinant, 1},
+    {"inv", BatchOp::Inverse, 1},
+    {"transpose", BatchOp::Transpose, 1},
+    {"trace", BatchOp::Trace, 1},
+    {"rref", BatchOp::Rref, 1},
+    {"mean", BatchOp::Mean, 1},
+    {"var", BatchOp::Variance, 1},
+    {"std", BatchOp::StdDev, 1},
+    {"median", BatchOp::Median, 1},
+    {"quantile", BatchOp::Quantile, 1},
+};
+
+static const OpEntry &entry(BatchOp op) {
+  for (const OpEntry &e : OPS) {
+    if (e.op == op)
+      return e;
+  }
+  throw std::invalid_argument("Unknown operation");
+}
+
+static bool isVectorOp(BatchOp op) {
+  return op == BatchOp::Mean || op == BatchOp::Variance ||
+         op == BatchOp::StdDev || op == BatchOp::Median ||
+         op == BatchOp::Quantile;
+}
+
+// Minimal tokenizer over one line; numbers are parsed in place with
+// from_chars, so a job costs no allocations beyond its operands.
+class LineReader {
+private:
+  const char *pos;
+  const char *end;
+
+  void skipSpace() {
+    while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\r'))
+      pos++;
+  }
+
+public:
+  LineReader(const char *begin, const char *finish)
+      : pos(begin), end(finish) {}
+
+  bool atEnd() {
+    skipSpace();
+    return pos == end;
+  }
+
+  std::size_t remaining() const {
+    return static_cast<std::size_t>(end - pos);
+  }
+
+  std::string word() {
+    skipSpace();
+    const char *start = pos;
+    while (pos < end && *pos != ' ' && *pos != '\t' && *pos != '\r')
+      pos++;
+    return std::string(start, pos);
+  }
+
+  int integer() {
+    skipSpace();
+    int value = 0;
+    auto res = std::from_chars(pos, end, value);
+    if (res.ec != std::errc())
+      throw std::invalid_argument("Expected an integer");
+    pos = res.ptr;
+    return value;
+  }
+
+  double number() {
+    skipSpace();
+    double value = 0.0;
+    auto res = std::from_chars(pos, end, value);
+    if (res.ec != std::errc())
+      throw std::invalid_argument("Expected a number");
+    pos = res.ptr;
+    return value;
+  }
+
+  // Each value takes at least two characters ("1 "), which bounds the
+  // allocation for a malformed size before any values are read
+  void requireValues(long long count) {
+    if (count > static_cast<long long>(remaining()) / 2 + 1)
+      throw std::invalid_argument("Not enough values for operand");
+  }
+
+  // "file <path>" loads a binary matrix file (MatrixFile.h)
+  bool fileOperand() {
+    skipSpace();
+    if (end - pos < 5 || std::string(pos, 5) != "file ")
+      return false;
+    pos += 5;
+    return true;
+  }
+
+  Matrix matrix() {
+    if (fileOperand())
+      return readMatrixFile(word());
+    int r = integer();
+    int c = integer();
+    if (r <= 0 || c <= 0)
+      throw std::invalid_argument("Invalid dimensions");
+    requireValues(static_cast<long long>(r) * c);
+    Matrix m(r, c);
+    for (int i = 0; i < r; i++) {
+      double *row = m.rowPtr(i);
+      for (int j = 0; j < c; j++)
+        row[j] = number();
+    }
+    return m;
+  }
+
+  Matrix vector() {
+    if (fileOperand())
+      return readMatrixFile(word());
+    int n = integer();
+    if (n <= 0)
+      throw std::invalid_argument("Invalid vector length");
+    requireValues(n);
+    Matrix m(1, n);
+    double *row = m.rowPtr(0);
+    for (int j = 0; j < n; j++)
+      row[j] = number();
+    return m;
+  }
+};
+
+static void appendNumber(std::string &out, double value) {
+  char buf[32];
+  auto res = std::to_chars(buf, buf + sizeof(buf), value);
+  out.append(buf, res.ptr);
+}
+
+static std::vector<double> elements(const Matrix &m) {
+  std::vector<double> values;
+  values.reserve(static_cast<std::size_t>(m.getRows()) * m.getCols());
+  for (int i = 0; i < m.getRows(); i++)
+    values.insert(values.end(), m.rowPtr(i), m.rowPtr(i) + m.getCols());
+  return values;
+}
+
+static RunningStatistics summarize(const Matrix &m) {
+  RunningStatistics stats;
+  for (int i = 0; i < m.getRows(); i++)
+    stats.add(m.rowPtr(i), m.getCols());
+  return stats;
+}
+
+static Matrix rref(const Matrix &m) {
+  const long long elements = static_cast<long long>(m.getRows()) * m.getCols();
+  if (elements >= SPARSE_RREF_MIN_ELEMENTS) {
+    const SparseMatrix sparse = SparseMatrix::fromDense(m);
+    if (sparse.nonZeros() <=
+        static_cast<long long>(SPARSE_RREF_MAX_ROW_NONZEROS) * m.getRows())
+      return sparse.rref().toDense();
+  }
+  return m.rref();
+}
+
+static BatchResult scalarResult(double value) {
+  BatchResult result;
+  result.scalar = value;
+  return result;
+}
+
+static BatchResult matrixResult(Matrix m) {
+  BatchResult result;
+  result.isScalar = false;
+  result.matrix = std::move(m);
+  return result;
+}
+
+// Lookup
+
+bool parseBatchOp(const std::string &name, BatchOp &op) {
+  for (const OpEntry &e : OPS) {
+    if (name == e.name) {
+      op = e.op;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char *batchOpName(BatchOp op) { return entry(op).name; }
+
+int batchOpArity(BatchOp op) { return entry(op).arity; }
+
+// Execution
+
+BatchResult runOperation(BatchOp op, const std::vector<Matrix> &args,
+                         double param) {
+  if (static_cast<int>(args.size()) != batchOpArity(op))
+    throw std::invalid_argument("Wrong number of operands");
+  const Matrix &a = args[0];
+  switch (op) {
+  case BatchOp::Add:
+    return matrixResult(a + args[1]);
+  case BatchOp::Subtract:
+    return matrixResult(a - args[1]);
+  case BatchOp::Multiply:
+    return matrixResult(a * args[1]);
+  case BatchOp::Solve:
+    return matrixResult(Matrix::solve(a, args[1]));
+  case BatchOp::Determinant:
+    return scalarResult(a.determinant());
+  case BatchOp::Inverse:
+    return matrixResult(a.inverse());
+  case BatchOp::Transpose:
+    return matrixResult(a.transpose());
+  case BatchOp::Trace:
+    return scalarResult(a.trace());
+  case BatchOp::Rref:
+    return matrixResult(rref(a));
+  case BatchOp::Mean:
+    return scalarResult(summarize(a).getMean());
+  case BatchOp::Variance:
+    return scalarResult(summarize(a).getVariance());
+  case BatchOp::StdDev:
+    return scalarResult(summarize(a).getStandardDeviation());
+  case BatchOp::Median:
+    return scalarResult(Statistics::calculateMedian(elements(a)));
+  case BatchOp::Quantile:
+    if (!(param >= 0.0 && param <= 1.0))
+      throw std::invalid_argument("Quantile must be between 0 and 1");
+    return scalarResult(Statistics::calculateQuantile(elements(a), param));
+  }
+  throw std::invalid_argument("Unknown operation");
+}
+
+std::string runBatchLine(const std::string &line) {
+  std::string out;
+  try {
+    LineReader reader(line.data(), line.data() + line.size());
+    std::string name = reader.word();
+    BatchOp op;
+    if (!parseBatchOp(name, op))
+      throw std::invalid_argument("Unknown operation '" + name + "'");
+
+    double param = 0.0;
+    if (op == BatchOp::Quantile)
+      param = reader.number();
+    std::vector<Matrix> args;
+    for (int i = 0; i < batchOpArity(op); i++)
+      args.push_back(isVectorOp(op) ? reader.vector() : reader.matrix());
+    if (!reader.atEnd())
+      throw std::invalid_argument("Unexpected trailing input");
+
+    BatchResult result = runOperation(op, args, param);
+    out = "ok ";
+    if (result.isScalar) {
+      appendNumber(out, result.scalar);
+      return out;
+    }
+    const Matrix &m = result.matrix;
+    out += std::to_string(m.getRows()) + ' ' + std::to_string(m.getCols());
+    for (int i = 0; i < m.getRows(); i++) {
+      const double *row = m.rowPtr(i);
+      for (int j = 0; j < m.getCols(); j++) {
+        out += ' ';
+        appendNumber(out, row[j]);
+      }
+    }
+  } catch (const std::exception &e) {
+    out = "error ";
+    out += e.what();
+  }
+  return out;
+}
+
+int runBatch(std::istream &in, std::ostream &out) {
+  std::vector<std::string> jobs;
+  std::vector<std::string> results;
+  std::string line;
+  int failures = 0;
+  bool more = true;
+  while (more) {
+    jobs.clear();
+    std::size_t chars = 0;
+    while (static_cast<int>(jobs.size()) < BATCH_CHUNK) {
+      if (!std::getline(in, line)) {
+        more = false;
+        break;
+      }
+      std::size_t start = line.find_first_not_of(" \t\r");
+      if (start == std::string::npos || line[start] == '#')
+        continue;
+      chars += line.size();
+      jobs.push_back(std::move(line));
+    }
+    if (jobs.empty())
+      break;
+
+    const int count = static_cast<int>(jobs.size());
+    results.assign(count, std::string());
+    // Each job's matrices die with it: recycle them through a per-thread
+    // arena instead of the shared heap
+    parallelRange(count, static_cast<long long>(chars / count),
+                  [&](int begin, int end) {
+                    MatrixArena arena;
+                    for (int i = begin; i < end; i++)
+                      results[i] = runBatchLine(jobs[i]);
+                  });
+    for (const std::string &r : results) {
+      if (r.compare(0, 5, "error") == 0)
+        failures++;
+      out << r << '\n';
+    }
+  }
+  out.flush();
+  return failures;
+}
@@ -0,0 +1,79 @@
+#ifndef BATCH_MODE_H
+#define BATCH_MODE_H
+
+#include "Matrix.h"
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Headless execution of calculator operations (main --batch).
+//
+// A script has one job per line. A job is an operation name followed by
+// its operands; blank lines and lines starting with '#' are skipped:
+//
+//   add 2 2 1 2 3 4  2 2 5 6 7 8     matrix operand: rows cols values...
+//   det 2 2 4 2 3 1
+//   mean 4 1 2 3 4                   vector operand: n values...
+//   quantile 0.9 4 1 2 3 4           parameter, then vector
+//   mul file a.mat file b.mat        binary matrix files (MatrixFile.h)
+//
+// Every job writes exactly one line, in input order:
+//
+//   ok <value>                       scalar result
+//   ok <rows> <cols> <values...>     matrix result (same form as an operand)
+//   error <message>
+//
+// Numbers are written in shortest round-trip form, so results can be fed
+// back in as operands without loss.
+//
+// The values are the operation codes of the server protocol
+// (MatrixServer.h), so existing ones must not change.
+enum class BatchOp {
+  Add = 0,
+  Subtract = 1,
+  Multiply = 2,
+  Solve = 3,
+  Determinant = 4,
+  Inverse = 5,
+  Transpose = 6,
+  Trace = 7,
+  Rref = 8,
+  Mean = 9,
+  Variance = 10,
+  StdDev = 11,
+  Median = 12,
+  Quantile = 13
+};
+
+// Result of one operation: a scalar or a matrix
+struct BatchResult {
+  bool isScalar;
+  double scalar;
+  Matrix matrix;
+
+  BatchResult() : isScalar(true), scalar(0.0) {}
+};
+
+// Operation names accepted in scripts ("add", "det", "quantile", ...)
+bool parseBatchOp(const std::string &name, BatchOp &op);
+const char *batchOpName(BatchOp op);
+
+// Number of matrix/vector operands the operation takes
+int batchOpArity(BatchOp op);
+
+// Runs one operation. Statistics operations use every element of their
+// operand; param is the quantile for BatchOp::Quantile. Throws the same
+// exceptions as the underlying Matrix/Statistics code.
+BatchResult runOperation(BatchOp op, const std::vector<Matrix> &args,
+                         double param = 0.0);
+
+// Parses and runs one script line, returning its "ok ..."/"error ..." line
+// without the trailing newline
+std::string runBatchLine(const std::string &line);
+
+// Runs every job in the stream and returns the number of failed jobs.
+// Jobs are read in chunks and executed in parallel on the shared pool;
+// output order always matches input order.
+int runBatch(std::istream &in, std::ostream &out);
+
+#endif
@@ -0,0 +1,335 @@
+#ifndef FIXED_MATRIX_H
+#define FIXED_MATRIX_H
+
+// Compile-time sized matrix for the small (2x2 .. 5x5) case.
+//
+// Elements live inline (no heap allocation), dimensions are template
+// parameters, and every operation is constexpr. Element-wise operations
+// and products are expanded over std::index_sequence, so they compile to
+// straight-line code with no loops. Determinant and inverse use closed
+// forms up to 3x3 (determinant up to 4x4) and pivoted elimination with
+// constant trip counts above that.
+
+#include "Matrix.h"
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+
+template <int R, int C> class FixedMatrix {
+  static_assert(R > 0 && C > 0, "FixedMatrix dimensions must be positive");
+
+  template <int, int> friend class FixedMatrix;
+
+private:
+  std::array<double, R * C> data;
+
+  static constexpr double absValue(double x) { return x < 0 ? -x : x; }
+
+  // Element-wise helpers, expanded over every index
+  template <typename Op, std::size_t... I>
+  constexpr FixedMatrix combine(const FixedMatrix &other, Op op,
+                                std::index_sequence<I...>) const {
+    FixedMatrix result;
+    ((result.data[I] = op(data[I], other.data[I])), ...);
+    return result;
+  }
+
+  template <std::size_t... I>
+  constexpr FixedMatrix scale(double scalar, std::index_sequence<I...>) const {
+    FixedMatrix result;
+    ((result.data[I] = data[I] * scalar), ...);
+    return result;
+  }
+
+  template <std::size_t... I>
+  constexpr FixedMatrix<C, R> transposeImpl(std::index_sequence<I...>) const {
+    FixedMatrix<C, R> result;
+    ((result.data[I] = data[(I % R) * C + I / R]), ...);
+    return result;
+  }
+
+  // Dot product of row I of *this with column J of other
+  template <int K, std::size_t... P>
+  constexpr double dot(int i, int j, const FixedMatrix<C, K> &other,
+                       std::index_sequence<P...>) const {
+    return ((data[i * C + P] * other.data[P * K + j]) + ...);
+  }
+
+  template <int K, std::size_t... I>
+  constexpr FixedMatrix<R, K> multiply(const FixedMatrix<C, K> &other,
+                                       std::index_sequence<I...>) const {
+    FixedMatrix<R, K> result;
+    ((result.data[I] = dot<K>(int(I) / K, int(I) % K, other,
+                              std::make_index_sequence<C>())),
+     ...);
+    return result;
+  }
+
+  // Copy without row `row` and column `col`
+  template <std::size_t... I>
+  constexpr FixedMatrix<R - 1, C - 1>
+  minorImpl(int row, int col, std::index_sequence<I...>) const {
+    FixedMatrix<R - 1, C - 1> result;
+    ((result.data[I] = data[(int(I) / (C - 1) + (int(I) / (C - 1) >= row)) * C +
+                            int(I) % (C - 1) + (int(I) % (C - 1) >= col)]),
+     ...);
+    return result;
+  }
+
+  // Laplace expansion along the first row
+  template <std::size_t... J>
+  constexpr double laplace(std::index_sequence<J...>) const {
+    return (((J % 2 == 0 ? 1.0 : -1.0) * data[J] *
+             minorImpl(0, int(J), std::make_index_sequence<(R - 1) * (C - 1)>())
+                 .determinant()) +
+            ...);
+  }
+
+  // Determinant by Gaussian elimination with partial pivoting
+  constexpr double eliminationDeterminant() const {
+    FixedMatrix a = *this;
+    double det = 1.0;
+    for (int k = 0; k < R; k++) {
+      int p = k;
+      for (int i = k + 1; i < R; i++)
+        if (absValue(a.data[i * C + k]) > absValue(a.data[p * C + k]))
+          p = i;
+      if (a.data[p * C + k] == 0.0)
+        return 0.0;
+      if (p != k) {
+        for (int j = 0; j < C; j++) {
+          double t = a.data[k * C + j];
+          a.data[k * C + j] = a.data[p * C + j];
+          a.data[p * C + j] = t;
+        }
+        det = -det;
+      }
+      const double pivot = a.data[k * C + k];
+      det *= pivot;
+      for (int i = k + 1; i < R; i++) {
+        const double factor = a.data[i * C + k] / pivot;
+        for (int j = k + 1; j < C; j++)
+          a.data[i * C + j] -= factor * a.data[k * C + j];
+      }
+    }
+    return det;
+  }
+
+  // Whether partial-pivoting elimination meets a pivot below EPSILON: the
+  // singularity test of LUDecomposition, so the closed-form inverses
+  // below fail for exactly the matrices Matrix::inverse rejects
+  constexpr bool hasSmallPivot() const {
+    FixedMatrix a = *this;
+    for (int k = 0; k < R; k++) {
+      int p = k;
+      for (int i = k + 1; i < R; i++)
+        if (absValue(a.data[i * C + k]) > absValue(a.data[p * C + k]))
+          p = i;
+      if (absValue(a.data[p * C + k]) < EPSILON)
+        return true;
+      for (int j = k; j < C; j++) {
+        double t = a.data[k * C + j];
+        a.data[k * C + j] = a.data[p * C + j];
+        a.data[p * C + j] = t;
+      }
+      const double pivot = a.data[k * C + k];
+      for (int i = k + 1; i < R; i++) {
+        const double factor = a.data[i * C + k] / pivot;
+        for (int j = k + 1; j < C; j++)
+          a.data[i * C + j] -= factor * a.data[k * C + j];
+      }
+    }
+    return false;
+  }
+
+  // Inverse by Gauss-Jordan elimination with partial pivoting
+  constexpr FixedMatrix eliminationInverse() const {
+    FixedMatrix a = *this;
+    FixedMatrix inv = identity();
+    for (int k = 0; k < R; k++) {
+      int p = k;
+      for (int i = k + 1; i < R; i++)
+        if (absValue(a.data[i * C + k]) > absValue(a.data[p * C + k]))
+          p = i;
+      if (absValue(a.data[p * C + k]) < EPSILON)
+        throw std::runtime_error("Matrix is singular and cannot be inverted");
+      if (p != k) {
+        for (int j = 0; j < C; j++) {
+          double t = a.data[k * C + j];
+          a.data[k * C + j] = a.data[p * C + j];
+          a.data[p * C + j] = t;
+          t = inv.data[k * C + j];
+          inv.data[k * C + j] = inv.data[p * C + j];
+          inv.data[p * C + j] = t;
+        }
+      }
+      const double invPivot = 1.0 / a.data[k * C + k];
+      for (int j = 0; j < C; j++) {
+        a.data[k * C + j] *= invPivot;
+        inv.data[k * C + j] *= invPivot;
+      }
+      for (int i = 0; i < R; i++) {
+        if (i == k)
+          continue;
+        const double factor = a.data[i * C + k];
+        for (int j = 0; j < C; j++) {
+          a.data[i * C + j] -= factor * a.data[k * C + j];
+          inv.data[i * C + j] -= factor * inv.data[k * C + j];
+        }
+      }
+    }
+    return inv;
+  }
+
+public:
+  // Constructors
+  constexpr FixedMatrix() : data{} {}
+  constexpr FixedMatrix(const double (&values)[R][C]) : data{} {
+    for (int i = 0; i < R; i++)
+      for (int j = 0; j < C; j++)
+        data[i * C + j] = values[i][j];
+  }
+
+  // Conversion from/to the dynamically sized Matrix
+  explicit FixedMatrix(const Matrix &m) : data{} {
+    if (m.getRows() != R || m.getCols() != C) {
+      throw std::invalid_argument("Matrix dimensions do not match FixedMatrix");
+    }
+    for (int i = 0; i < R; i++)
+      for (int j = 0; j < C; j++)
+        data[i * C + j] = m.rowPtr(i)[j];
+  }
+
+  Matrix toMatrix() const {
+    Matrix m(R, C);
+    for (int i = 0; i < R; i++)
+      for (int j = 0; j < C; j++)
+        m.rowPtr(i)[j] = data[i * C + j];
+    return m;
+  }
+
+  // Getters
+  static constexpr int getRows() { return R; }
+  static constexpr int getCols() { return C; }
+
+  // Unchecked access
+  constexpr double operator()(int i, int j) const { return data[i * C + j]; }
+  constexpr double &operator()(int i, int j) { return data[i * C + j]; }
+
+  // Compile-time checked access
+  template <int I, int J> constexpr double get() const {
+    static_assert(I >= 0 && I < R && J >= 0 && J < C,
+                  "FixedMatrix index out of range");
+    return data[I * C + J];
+  }
+
+  // Runtime checked access, matching Matrix::get / Matrix::set
+  constexpr double get(int i, int j) const {
+    if (i < 0 || i >= R || j < 0 || j >= C)
+      throw std::out_of_range("Matrix indices out of range");
+    return data[i * C + j];
+  }
+  constexpr void set(int i, int j, double value) {
+    if (i < 0 || i >= R || j < 0 || j >= C)
+      throw std::out_of_range("Matrix indices out of range");
+    data[i * C + j] = value;
+  }
+
+  void display() const { toMatrix().display(); }
+
+  // Basic Operations
+  constexpr FixedMatrix operator+(const FixedMatrix &other) const {
+    return combine(other, [](double a, double b) { return a + b; },
+                   std::make_index_sequence<R * C>());
+  }
+  constexpr FixedMatrix operator-(const FixedMatrix &other) const {
+    return combine(other, [](double a, double b) { return a - b; },
+                   std::make_index_sequence<R * C>());
+  }
+  constexpr FixedMatrix operator*(double scalar) const {
+    return scale(scalar, std::make_index_sequence<R * C>());
+  }
+  template <int K>
+  constexpr FixedMatrix<R, K> operator*(const FixedMatrix<C, K> &other) const {
+    return multiply(other, std::make_index_sequence<R * K>());
+  }
+  constexpr FixedMatrix<C, R> transpose() const {
+    return transposeImpl(std::make_index_sequence<R * C>());
+  }
+
+  // Advanced Operations (square only)
+  constexpr double trace() const {
+    static_assert(R == C, "Trace is only defined for square matrices");
+    double tr = 0.0;
+    for (int i = 0; i < R; i++)
+      tr += data[i * C + i];
+    return tr;
+  }
+
+  constexpr double determinant() const {
+    static_assert(R == C, "Determinant is only defined for square matrices");
+    if constexpr (R == 1) {
+      return data[0];
+    } else if constexpr (R == 2) {
+      return data[0] * data[3] - data[1] * data[2];
+    } else if constexpr (R == 3) {
+      return data[0] * (data[4] * data[8] - data[5] * data[7]) -
+             data[1] * (data[3] * data[8] - data[5] * data[6]) +
+             data[2] * (data[3] * data[7] - data[4] * data[6]);
+    } else if constexpr (R == 4) {
+      return laplace(std::make_index_sequence<C>());
+    } else {
+      return eliminationDeterminant();
+    }
+  }
+
+  constexpr FixedMatrix inverse() const {
+    static_assert(R == C, "Only square matrices can be inverted");
+    if constexpr (R <= 3) {
+      if (hasSmallPivot())
+        throw std::runtime_error("Matrix is singular and cannot be inverted");
+      const double det = determinant();
+      const double invDet = 1.0 / det;
+      FixedMatrix inv;
+      if constexpr (R == 1) {
+        inv.data[0] = invDet;
+      } else if constexpr (R == 2) {
+        inv.data = {data[3] * invDet, -data[1] * invDet, -data[2] * invDet,
+                    data[0] * invDet};
+      } else {
+        const std::array<double, 9> &a = data;
+        inv.data = {(a[4] * a[8] - a[5] * a[7]) * invDet,
+                    (a[2] * a[7] - a[1] * a[8]) * invDet,
+                    (a[1] * a[5] - a[2] * a[4]) * invDet,
+                    (a[5] * a[6] - a[3] * a[8]) * invDet,
+                    (a[0] * a[8] - a[2] * a[6]) * invDet,
+                    (a[2] * a[3] - a[0] * a[5]) * invDet,
+                    (a[3] * a[7] - a[4] * a[6]) * invDet,
+                    (a[1] * a[6] - a[0] * a[7]) * invDet,
+                    (a[0] * a[4] - a[1] * a[3]) * invDet};
+      }
+      return inv;
+    } else {
+      return eliminationInverse();
+    }
+  }
+
+  // Static methods
+  static constexpr FixedMatrix identity() {
+    static_assert(R == C, "Identity matrix must be square");
+    FixedMatrix I;
+    for (int i = 0; i < R; i++)
+      I.data[i * C + i] = 1.0;
+    return I;
+  }
+  static constexpr FixedMatrix zero() { return FixedMatrix(); }
+};
+
+template <int R, int C>
+constexpr FixedMatrix<R, C> operator*(double scalar,
+                                      const FixedMatrix<R, C> &m) {
+  return m * scalar;
+}
+
+#endif
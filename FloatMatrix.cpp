@@ -0,0 +1,285 @@
+#include "FloatMatrix.h"
+#include "Gemm.h"
+#include "LUDecomposition.h"
+#include "MatrixArena.h"
+#include "Profiler.h"
+#include "TriangularSolve.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+static void profileStorage(std::size_t elements) {
+  if (Profiler::enabled())
+    Profiler::addAllocation(elements * sizeof(float));
+}
+
+// Constructors
+FloatMatrix::FloatMatrix(int r, int c)
+    : data(MatrixResourceScope::current()), rows(r), cols(c) {
+  if (r <= 0 || c <= 0) {
+    throw std::invalid_argument("Matrix dimensions must be positive");
+  }
+  data.assign(std::size_t(r) * c, 0.0f);
+  profileStorage(data.size());
+}
+
+FloatMatrix::FloatMatrix(const MatrixView &view)
+    : FloatMatrix(view.getRows(), view.getCols()) {
+  for (int i = 0; i < rows; i++) {
+    const double *src = view.rowPtr(i);
+    float *dst = rowPtr(i);
+    for (int j = 0; j < cols; j++)
+      dst[j] = static_cast<float>(src[j]);
+  }
+}
+
+// Element access
+float FloatMatrix::get(int i, int j) const {
+  if (i < 0 || i >= rows || j < 0 || j >= cols) {
+    throw std::out_of_range("Matrix indices out of range");
+  }
+  return rowPtr(i)[j];
+}
+
+void FloatMatrix::set(int i, int j, float value) {
+  if (i < 0 || i >= rows || j < 0 || j >= cols) {
+    throw std::out_of_range("Matrix indices out of range");
+  }
+  rowPtr(i)[j] = value;
+}
+
+Matrix FloatMatrix::toMatrix() const {
+  Matrix result(rows, cols);
+  for (int i = 0; i < rows; i++) {
+    const float *src = rowPtr(i);
+    double *dst = result.rowPtr(i);
+    for (int j = 0; j < cols; j++)
+      dst[j] = src[j];
+  }
+  return result;
+}
+
+// Basic operations
+FloatMatrix FloatMatrix::operator*(const FloatMatrix &other) const {
+  if (cols != other.rows) {
+    throw std::invalid_argument("Invalid dimensions for matrix multiplication");
+  }
+  ProfileScope profile(ProfileOp::Multiply,
+                       std::max({rows, cols, other.cols}),
+                       2.0 * rows * cols * other.cols);
+  FloatMatrix result(rows, other.cols);
+  gemm(rows, other.cols, cols, rowPtr(0), cols, other.rowPtr(0), other.cols,
+       result.rowPtr(0), result.cols);
+  return result;
+}
+
+FloatMatrix FloatMatrix::transpose() const {
+  ProfileScope profile(ProfileOp::Transpose, std::max(rows, cols));
+  FloatMatrix result(cols, rows);
+  for (int i = 0; i < rows; i++) {
+    const float *row = rowPtr(i);
+    for (int j = 0; j < cols; j++)
+      result.rowPtr(j)[i] = row[j];
+  }
+  return result;
+}
+
+void FloatMatrix::swapRows(int i, int j) {
+  if (i < 0 || i >= rows || j < 0 || j >= rows) {
+    throw std::out_of_range("Row index out of range");
+  }
+  if (i != j)
+    std::swap_ranges(rowPtr(i), rowPtr(i) + cols, rowPtr(j));
+}
+
+// Blocked right-looking elimination. Pivoting looks at whole columns, so
+// the pivots (and the factors) match the unblocked algorithm up to
+// rounding.
+FloatLUDecomposition::FloatLUDecomposition(const FloatMatrix &A)
+    : lu(A), perm(A.getRows()), singular(false) {
+  if (A.getRows() != A.getCols()) {
+    throw std::invalid_argument("LU decomposition requires a square matrix");
+  }
+  const int n = lu.getRows();
+  ProfileScope profile(ProfileOp::LUFactorization, n,
+                       2.0 * n * n * n / 3.0);
+  std::iota(perm.begin(), perm.end(), 0);
+
+  float *a = lu.rowPtr(0);
+  const std::size_t ld = n;
+  std::vector<float> negatedL; // -L21 of the current panel, for gemm
+  for (int k0 = 0; k0 < n; k0 += LU_BLOCK) {
+    const int k1 = std::min(n, k0 + LU_BLOCK);
+
+    // Panel: columns [k0, k1) of rows k0 and below
+    for (int k = k0; k < k1; k++) {
+      int p = k;
+      float maxAbs = std::abs(a[k * ld + k]);
+      for (int i = k + 1; i < n; i++) {
+        float v = std::abs(a[i * ld + k]);
+        if (v > maxAbs) {
+          maxAbs = v;
+          p = i;
+        }
+      }
+      if (p != k) {
+        lu.swapRows(p, k);
+        std::swap(perm[p], perm[k]);
+      }
+      if (maxAbs == 0.0f) {
+        singular = true;
+        continue;
+      }
+      const float *pivotRow = a + k * ld;
+      const float pivot = pivotRow[k];
+      for (int i = k + 1; i < n; i++) {
+        float *row = a + i * ld;
+        const float factor = row[k] / pivot;
+        row[k] = factor;
+        if (factor == 0.0f)
+          continue;
+        for (int j = k + 1; j < k1; j++)
+          row[j] -= factor * pivotRow[j];
+      }
+    }
+    if (k1 == n)
+      break;
+
+    // U12 = L11^-1 * A12, row by row
+    for (int i = k0 + 1; i < k1; i++) {
+      float *row = a + i * ld;
+      for (int k = k0; k < i; k++) {
+        const float factor = row[k];
+        if (factor == 0.0f)
+          continue;
+        const float *uk = a + k * ld;
+        for (int j = k1; j < n; j++)
+          row[j] -= factor * uk[j];
+      }
+    }
+
+    // A22 += (-L21) * U12
+    const int rest = n - k1;
+    const int width = k1 - k0;
+    negatedL.resize(static_cast<std::size_t>(rest) * width);
+    for (int i = 0; i < rest; i++) {
+      const float *l = a + (k1 + i) * ld + k0;
+      for (int k = 0; k < width; k++)
+        negatedL[i * width + k] = -l[k];
+    }
+    gemm(rest, rest, width, negatedL.data(), width, a + k0 * ld + k1, n,
+         a + k1 * ld + k1, n);
+  }
+}
+
+void FloatLUDecomposition::solveInPlace(FloatMatrix &x) const {
+  luSolveInPlace(size(), lu.rowPtr(0), lu.getStride(), x.rowPtr(0),
+                 x.getCols(), x.getStride());
+}
+
+Matrix FloatLUDecomposition::solve(const Matrix &B) const {
+  if (B.getRows() != size()) {
+    throw std::invalid_argument(
+        "Right-hand side must have as many rows as the matrix");
+  }
+  if (singular) {
+    throw std::runtime_error(
+        "Matrix is singular; the system has no unique solution");
+  }
+  const int m = B.getCols();
+  FloatMatrix x(size(), m);
+  for (int i = 0; i < size(); i++) {
+    const double *src = B.rowPtr(perm[i]);
+    float *dst = x.rowPtr(i);
+    for (int j = 0; j < m; j++)
+      dst[j] = static_cast<float>(src[j]);
+  }
+  solveInPlace(x);
+  return x.toMatrix();
+}
+
+// Largest absolute value in each column
+static std::vector<double> columnMaxima(const Matrix &m) {
+  std::vector<double> result(m.getCols(), 0.0);
+  for (int i = 0; i < m.getRows(); i++) {
+    const double *row = m.rowPtr(i);
+    for (int j = 0; j < m.getCols(); j++)
+      result[j] = std::max(result[j], std::abs(row[j]));
+  }
+  return result;
+}
+
+static bool allFinite(const Matrix &m) {
+  for (int i = 0; i < m.getRows(); i++) {
+    const double *row = m.rowPtr(i);
+    for (int j = 0; j < m.getCols(); j++)
+      if (!std::isfinite(row[j]))
+        return false;
+  }
+  return true;
+}
+
+// Stopping test of LAPACK's dsgesv: every column of the residual is below
+// sqrt(n) * eps * ||A||_inf * ||x||_inf, i.e. X is as accurate as a double
+// precision solve would make it
+Matrix solveMixedPrecision(const Matrix &A, const Matrix &B,
+                           int *iterations) {
+  if (!A.isSquare()) {
+    throw std::invalid_argument("Only square systems can be solved");
+  }
+  if (B.getRows() != A.getRows()) {
+    throw std::invalid_argument(
+        "Right-hand side must have as many rows as the matrix");
+  }
+  const int n = A.getRows();
+  ProfileScope profile(ProfileOp::Solve, std::max(n, B.getCols()),
+                       2.0 * n * n * B.getCols());
+  if (iterations != nullptr)
+    *iterations = -1;
+
+  double normA = 0.0;
+  bool fitsFloat = true;
+  for (int i = 0; i < n && fitsFloat; i++) {
+    const double *row = A.rowPtr(i);
+    double sum = 0.0;
+    for (int j = 0; j < n; j++) {
+      const double v = std::abs(row[j]);
+      if (!(v <= FLT_MAX))
+        fitsFloat = false;
+      sum += v;
+    }
+    normA = std::max(normA, sum);
+  }
+
+  if (fitsFloat) {
+    const FloatLUDecomposition lu{FloatMatrix(A.view())};
+    if (!lu.isSingular()) {
+      const double tolerance =
+          std::sqrt(static_cast<double>(n)) *
+          std::numeric_limits<double>::epsilon() * normA;
+      Matrix X = lu.solve(B);
+      for (int step = 0; step <= MAX_REFINEMENT_STEPS; step++) {
+        if (!allFinite(X))
+          break;
+        Matrix R = B - A * X;
+        const std::vector<double> rMax = columnMaxima(R);
+        const std::vector<double> xMax = columnMaxima(X);
+        bool converged = true;
+        for (std::size_t j = 0; j < rMax.size() && converged; j++)
+          converged = rMax[j] <= xMax[j] * tolerance;
+        if (converged) {
+          if (iterations != nullptr)
+            *iterations = step;
+          return X;
+        }
+        if (step < MAX_REFINEMENT_STEPS)
+          X += lu.solve(R);
+      }
+    }
+  }
+  // Not Matrix::solve, which would record this call a second time
+  return A.luFactorization()->solve(B);
+}
@@ -0,0 +1,353 @@
+#include "Gemm.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GEMM_X86 1
+#include <immintrin.h>
+#endif
+
+// Register tile (MR x NR) and cache blocks: a KC x NR panel of B stays in
+// L1, an MC x KC block of A in L2 and a KC x NC block of B in L3. A tile
+// row is two AVX registers wide: 8 doubles or 16 floats.
+const int MR = 4;
+template <typename T> struct Tile;
+template <> struct Tile<double> {
+  static const int NR = 8;
+};
+template <> struct Tile<float> {
+  static const int NR = 16;
+};
+const int MC = 128;
+const int KC = 256;
+const int NC = 4096;
+
+// Below this many multiply-adds packing costs more than it saves
+const long long SMALL_GEMM = 16LL * 16 * 16;
+
+// Micro-kernel: C[0..MR)[0..NR) += Ap * Bp over kc packed steps
+template <typename T>
+using MicroKernel = void (*)(int kc, const T *a, const T *b, T *c, int ldc);
+
+template <typename T>
+static void kernelScalar(int kc, const T *a, const T *b, T *c, int ldc) {
+  const int NR = Tile<T>::NR;
+  T acc[MR][NR] = {};
+  for (int p = 0; p < kc; p++) {
+    for (int i = 0; i < MR; i++) {
+      const T ai = a[i];
+      for (int j = 0; j < NR; j++)
+        acc[i][j] += ai * b[j];
+    }
+    a += MR;
+    b += NR;
+  }
+  for (int i = 0; i < MR; i++)
+    for (int j = 0; j < NR; j++)
+      c[i * ldc + j] += acc[i][j];
+}
+
+#ifdef GEMM_X86
+static void kernelSse2(int kc, const double *a, const double *b, double *c,
+                       int ldc) {
+  const int NR = Tile<double>::NR;
+  __m128d acc[MR][NR / 2];
+  for (int i = 0; i < MR; i++)
+    for (int j = 0; j < NR / 2; j++)
+      acc[i][j] = _mm_setzero_pd();
+  for (int p = 0; p < kc; p++) {
+    const __m128d b0 = _mm_loadu_pd(b);
+    const __m128d b1 = _mm_loadu_pd(b + 2);
+    const __m128d b2 = _mm_loadu_pd(b + 4);
+    const __m128d b3 = _mm_loadu_pd(b + 6);
+    for (int i = 0; i < MR; i++) {
+      const __m128d ai = _mm_set1_pd(a[i]);
+      acc[i][0] = _mm_add_pd(acc[i][0], _mm_mul_pd(ai, b0));
+      acc[i][1] = _mm_add_pd(acc[i][1], _mm_mul_pd(ai, b1));
+      acc[i][2] = _mm_add_pd(acc[i][2], _mm_mul_pd(ai, b2));
+      acc[i][3] = _mm_add_pd(acc[i][3], _mm_mul_pd(ai, b3));
+    }
+    a += MR;
+    b += NR;
+  }
+  for (int i = 0; i < MR; i++) {
+    double *row = c + i * ldc;
+    for (int j = 0; j < NR / 2; j++)
+      _mm_storeu_pd(row + 2 * j,
+                    _mm_add_pd(_mm_loadu_pd(row + 2 * j), acc[i][j]));
+  }
+}
+
+__attribute__((target("avx2,fma"))) static void
+kernelAvx2(int kc, const double *a, const double *b, double *c, int ldc) {
+  __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+  __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+  __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+  __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+  for (int p = 0; p < kc; p++) {
+    const __m256d b0 = _mm256_loadu_pd(b);
+    const __m256d b1 = _mm256_loadu_pd(b + 4);
+    __m256d ai = _mm256_broadcast_sd(a);
+    c00 = _mm256_fmadd_pd(ai, b0, c00);
+    c01 = _mm256_fmadd_pd(ai, b1, c01);
+    ai = _mm256_broadcast_sd(a + 1);
+    c10 = _mm256_fmadd_pd(ai, b0, c10);
+    c11 = _mm256_fmadd_pd(ai, b1, c11);
+    ai = _mm256_broadcast_sd(a + 2);
+    c20 = _mm256_fmadd_pd(ai, b0, c20);
+    c21 = _mm256_fmadd_pd(ai, b1, c21);
+    ai = _mm256_broadcast_sd(a + 3);
+    c30 = _mm256_fmadd_pd(ai, b0, c30);
+    c31 = _mm256_fmadd_pd(ai, b1, c31);
+    a += MR;
+    b += Tile<double>::NR;
+  }
+  double *r0 = c, *r1 = c + ldc, *r2 = c + 2 * ldc, *r3 = c + 3 * ldc;
+  _mm256_storeu_pd(r0, _mm256_add_pd(_mm256_loadu_pd(r0), c00));
+  _mm256_storeu_pd(r0 + 4, _mm256_add_pd(_mm256_loadu_pd(r0 + 4), c01));
+  _mm256_storeu_pd(r1, _mm256_add_pd(_mm256_loadu_pd(r1), c10));
+  _mm256_storeu_pd(r1 + 4, _mm256_add_pd(_mm256_loadu_pd(r1 + 4), c11));
+  _mm256_storeu_pd(r2, _mm256_add_pd(_mm256_loadu_pd(r2), c20));
+  _mm256_storeu_pd(r2 + 4, _mm256_add_pd(_mm256_loadu_pd(r2 + 4), c21));
+  _mm256_storeu_pd(r3, _mm256_add_pd(_mm256_loadu_pd(r3), c30));
+  _mm256_storeu_pd(r3 + 4, _mm256_add_pd(_mm256_loadu_pd(r3 + 4), c31));
+}
+
+static void kernelSse2Float(int kc, const float *a, const float *b, float *c,
+                            int ldc) {
+  const int NR = Tile<float>::NR;
+  __m128 acc[MR][NR / 4];
+  for (int i = 0; i < MR; i++)
+    for (int j = 0; j < NR / 4; j++)
+      acc[i][j] = _mm_setzero_ps();
+  for (int p = 0; p < kc; p++) {
+    const __m128 b0 = _mm_loadu_ps(b);
+    const __m128 b1 = _mm_loadu_ps(b + 4);
+    const __m128 b2 = _mm_loadu_ps(b + 8);
+    const __m128 b3 = _mm_loadu_ps(b + 12);
+    for (int i = 0; i < MR; i++) {
+      const __m128 ai = _mm_set1_ps(a[i]);
+      acc[i][0] = _mm_add_ps(acc[i][0], _mm_mul_ps(ai, b0));
+      acc[i][1] = _mm_add_ps(acc[i][1], _mm_mul_ps(ai, b1));
+      acc[i][2] = _mm_add_ps(acc[i][2], _mm_mul_ps(ai, b2));
+      acc[i][3] = _mm_add_ps(acc[i][3], _mm_mul_ps(ai, b3));
+    }
+    a += MR;
+    b += NR;
+  }
+  for (int i = 0; i < MR; i++) {
+    float *row = c + i * ldc;
+    for (int j = 0; j < NR / 4; j++)
+      _mm_storeu_ps(row + 4 * j,
+                    _mm_add_ps(_mm_loadu_ps(row + 4 * j), acc[i][j]));
+  }
+}
+
+__attribute__((target("avx2,fma"))) static void
+kernelAvx2Float(int kc, const float *a, const float *b, float *c, int ldc) {
+  __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+  __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+  __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+  __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+  for (int p = 0; p < kc; p++) {
+    const __m256 b0 = _mm256_loadu_ps(b);
+    const __m256 b1 = _mm256_loadu_ps(b + 8);
+    __m256 ai = _mm256_broadcast_ss(a);
+    c00 = _mm256_fmadd_ps(ai, b0, c00);
+    c01 = _mm256_fmadd_ps(ai, b1, c01);
+    ai = _mm256_broadcast_ss(a + 1);
+    c10 = _mm256_fmadd_ps(ai, b0, c10);
+    c11 = _mm256_fmadd_ps(ai, b1, c11);
+    ai = _mm256_broadcast_ss(a + 2);
+    c20 = _mm256_fmadd_ps(ai, b0, c20);
+    c21 = _mm256_fmadd_ps(ai, b1, c21);
+    ai = _mm256_broadcast_ss(a + 3);
+    c30 = _mm256_fmadd_ps(ai, b0, c30);
+    c31 = _mm256_fmadd_ps(ai, b1, c31);
+    a += MR;
+    b += Tile<float>::NR;
+  }
+  float *r0 = c, *r1 = c + ldc, *r2 = c + 2 * ldc, *r3 = c + 3 * ldc;
+  _mm256_storeu_ps(r0, _mm256_add_ps(_mm256_loadu_ps(r0), c00));
+  _mm256_storeu_ps(r0 + 8, _mm256_add_ps(_mm256_loadu_ps(r0 + 8), c01));
+  _mm256_storeu_ps(r1, _mm256_add_ps(_mm256_loadu_ps(r1), c10));
+  _mm256_storeu_ps(r1 + 8, _mm256_add_ps(_mm256_loadu_ps(r1 + 8), c11));
+  _mm256_storeu_ps(r2, _mm256_add_ps(_mm256_loadu_ps(r2), c20));
+  _mm256_storeu_ps(r2 + 8, _mm256_add_ps(_mm256_loadu_ps(r2 + 8), c21));
+  _mm256_storeu_ps(r3, _mm256_add_ps(_mm256_loadu_ps(r3), c30));
+  _mm256_storeu_ps(r3 + 8, _mm256_add_ps(_mm256_loadu_ps(r3 + 8), c31));
+}
+#endif
+
+struct KernelChoice {
+  MicroKernel<double> kernel;
+  MicroKernel<float> kernelFloat;
+  const char *name;
+};
+
+static KernelChoice detectKernel() {
+#ifdef GEMM_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return {kernelAvx2, kernelAvx2Float, "avx2"};
+  if (__builtin_cpu_supports("sse2"))
+    return {kernelSse2, kernelSse2Float, "sse2"};
+#endif
+  return {kernelScalar<double>, kernelScalar<float>, "scalar"};
+}
+
+static const KernelChoice &selectedKernel() {
+  static const KernelChoice choice = detectKernel();
+  return choice;
+}
+
+const char *gemmKernelName() { return selectedKernel().name; }
+
+template <typename T> static MicroKernel<T> selectedMicroKernel();
+template <> MicroKernel<double> selectedMicroKernel<double>() {
+  return selectedKernel().kernel;
+}
+template <> MicroKernel<float> selectedMicroKernel<float>() {
+  return selectedKernel().kernelFloat;
+}
+
+// Copies an mc x kc block of A into MR-row panels, zero-padding the last one
+template <typename T>
+static void packA(int mc, int kc, const T *A, int lda, T *out) {
+  for (int ir = 0; ir < mc; ir += MR) {
+    const int mr = std::min(MR, mc - ir);
+    for (int p = 0; p < kc; p++) {
+      for (int i = 0; i < mr; i++)
+        out[i] = A[(ir + i) * static_cast<long long>(lda) + p];
+      for (int i = mr; i < MR; i++)
+        out[i] = 0.0;
+      out += MR;
+    }
+  }
+}
+
+// Copies a kc x nc block of B into NR-column panels, zero-padding the last
+template <typename T>
+static void packB(int kc, int nc, const T *B, int ldb, T *out) {
+  const int NR = Tile<T>::NR;
+  for (int jr = 0; jr < nc; jr += NR) {
+    const int nr = std::min(NR, nc - jr);
+    for (int p = 0; p < kc; p++) {
+      const T *src = B + p * static_cast<long long>(ldb) + jr;
+      for (int j = 0; j < nr; j++)
+        out[j] = src[j];
+      for (int j = nr; j < NR; j++)
+        out[j] = 0.0;
+      out += NR;
+    }
+  }
+}
+
+template <typename T>
+static void macroKernel(int mc, int nc, int kc, const T *Ap, const T *Bp,
+                        T *C, int ldc, MicroKernel<T> kernel) {
+  const int NR = Tile<T>::NR;
+  for (int jr = 0; jr < nc; jr += NR) {
+    const int nr = std::min(NR, nc - jr);
+    const T *b = Bp + static_cast<long long>(jr) * kc;
+    for (int ir = 0; ir < mc; ir += MR) {
+      const int mr = std::min(MR, mc - ir);
+      const T *a = Ap + static_cast<long long>(ir) * kc;
+      T *c = C + ir * static_cast<long long>(ldc) + jr;
+      if (mr == MR && nr == NR) {
+        kernel(kc, a, b, c, ldc);
+      } else {
+        // Edge tile: accumulate into a scratch tile, copy back what fits
+        T tile[MR * NR] = {};
+        kernel(kc, a, b, tile, NR);
+        for (int i = 0; i < mr; i++)
+          for (int j = 0; j < nr; j++)
+            c[i * static_cast<long long>(ldc) + j] += tile[i * NR + j];
+      }
+    }
+  }
+}
+
+template <typename T>
+static void gemmSmall(int m, int n, int k, const T *A, int lda, const T *B,
+                      int ldb, T *C, int ldc) {
+  for (int i = 0; i < m; i++) {
+    const T *a = A + i * static_cast<long long>(lda);
+    T *c = C + i * static_cast<long long>(ldc);
+    for (int p = 0; p < k; p++) {
+      const T aip = a[p];
+      const T *b = B + p * static_cast<long long>(ldb);
+      for (int j = 0; j < n; j++)
+        c[j] += aip * b[j];
+    }
+  }
+}
+
+// Per-thread packing buffers are sized for the blocks actually used and
+// only ever grow, so small products never touch a full KC x NC buffer
+template <typename T>
+static T *growBuffer(std::vector<T> &buffer, std::size_t size) {
+  if (buffer.size() < size)
+    buffer.resize(size);
+  return buffer.data();
+}
+
+template <typename T>
+static void gemmBlocked(int m, int n, int k, const T *A, int lda, const T *B,
+                        int ldb, T *C, int ldc) {
+  const int NR = Tile<T>::NR;
+  if (m <= 0 || n <= 0 || k <= 0)
+    return;
+  if (static_cast<long long>(m) * n * k <= SMALL_GEMM) {
+    gemmSmall(m, n, k, A, lda, B, ldb, C, ldc);
+    return;
+  }
+
+  const MicroKernel<T> kernel = selectedMicroKernel<T>();
+
+  // Row blocks of C are shared out across the pool. With few rows the
+  // blocks shrink (down to MR) so that every thread still gets some.
+  const int threads = ThreadPool::inParallelRegion()
+                          ? 1
+                          : ThreadPool::instance().getThreadCount();
+  int mcBlock = (m + threads - 1) / threads;
+  mcBlock = std::min(MC, std::max(MR, (mcBlock + MR - 1) / MR * MR));
+  const int mBlocks = (m + mcBlock - 1) / mcBlock;
+
+  const int kcMax = std::min(KC, k);
+  const int ncMax = (std::min(NC, n) + NR - 1) / NR * NR;
+  thread_local std::vector<T> bufB;
+  T *packedB = growBuffer(bufB, static_cast<std::size_t>(kcMax) * ncMax);
+
+  for (int jc = 0; jc < n; jc += NC) {
+    const int nc = std::min(NC, n - jc);
+    for (int pc = 0; pc < k; pc += KC) {
+      const int kc = std::min(KC, k - pc);
+      packB(kc, nc, B + pc * static_cast<long long>(ldb) + jc, ldb, packedB);
+      parallelRange(mBlocks, 2LL * mcBlock * nc * kc, [&](int first, int last) {
+        thread_local std::vector<T> bufA;
+        T *packedA =
+            growBuffer(bufA, static_cast<std::size_t>(mcBlock) * kcMax);
+        for (int blk = first; blk < last; blk++) {
+          const int ic = blk * mcBlock;
+          const int mc = std::min(mcBlock, m - ic);
+          packA(mc, kc, A + ic * static_cast<long long>(lda) + pc, lda,
+                packedA);
+          macroKernel(mc, nc, kc, packedA, packedB,
+                      C + ic * static_cast<long long>(ldc) + jc, ldc, kernel);
+        }
+      });
+    }
+  }
+}
+
+void gemm(int m, int n, int k, const double *A, int lda, const double *B,
+          int ldb, double *C, int ldc) {
+  gemmBlocked(m, n, k, A, lda, B, ldb, C, ldc);
+}
+
+void gemm(int m, int n, int k, const float *A, int lda, const float *B,
+          int ldb, float *C, int ldc) {
+  gemmBlocked(m, n, k, A, lda, B, ldb, C, ldc);
+}
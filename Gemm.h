@@ -0,0 +1,20 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+// General matrix multiply on row-major buffers: C += A * B, where A is
+// m x k, B is k x n and C is m x n. lda/ldb/ldc are the leading dimensions
+// (distance in elements between consecutive rows).
+//
+// Large products are packed into cache-sized blocks and run through a
+// register-blocked micro-kernel chosen once at runtime from the CPU
+// features (AVX2+FMA, SSE2, or portable scalar code).
+void gemm(int m, int n, int k, const double *A, int lda, const double *B,
+          int ldb, double *C, int ldc);
+// Single precision: twice the elements per SIMD register and per cache line
+void gemm(int m, int n, int k, const float *A, int lda, const float *B,
+          int ldb, float *C, int ldc);
+
+// Name of the micro-kernel selected for this CPU ("avx2", "sse2", "scalar")
+const char *gemmKernelName();
+
+#endif
@@ -0,0 +1,210 @@
+#include "IncrementalInverse.h"
+#include "LUDecomposition.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include <cmath>
+#include <stdexcept>
+
+IncrementalInverse::IncrementalInverse(const Matrix &A)
+    : matrix(A), inv(A.getRows(), A.getCols()), det(0.0), singular(true),
+      updatesSinceRefactor(0), refactorCount(0) {
+  if (!A.isSquare()) {
+    throw std::invalid_argument("Only square matrices can be inverted");
+  }
+  refactor();
+}
+
+const Matrix &IncrementalInverse::inverse() const {
+  if (singular) {
+    throw std::runtime_error("Matrix is singular and cannot be inverted");
+  }
+  return inv;
+}
+
+void IncrementalInverse::refactor() {
+  std::shared_ptr<const LUDecomposition> lu = matrix.luFactorization();
+  det = lu->determinant();
+  singular = lu->isSingular();
+  if (!singular)
+    inv = lu->inverse();
+  updatesSinceRefactor = 0;
+  refactorCount++;
+}
+
+// Helpers
+
+static void checkLength(const std::vector<double> &x, int n) {
+  if (static_cast<int>(x.size()) != n) {
+    throw std::invalid_argument("Vector length must match the matrix size");
+  }
+}
+
+static std::vector<double> column(const Matrix &m, int j) {
+  std::vector<double> result(m.getRows());
+  for (int i = 0; i < m.getRows(); i++)
+    result[i] = m.rowPtr(i)[j];
+  return result;
+}
+
+static std::vector<double> row(const Matrix &m, int i) {
+  return std::vector<double>(m.rowPtr(i), m.rowPtr(i) + m.getCols());
+}
+
+// m * x
+static std::vector<double> multiply(const Matrix &m,
+                                    const std::vector<double> &x) {
+  const int n = m.getCols();
+  std::vector<double> result(m.getRows());
+  parallelRange(m.getRows(), n, [&](int first, int last) {
+    for (int i = first; i < last; i++) {
+      const double *r = m.rowPtr(i);
+      double sum = 0.0;
+      for (int j = 0; j < n; j++)
+        sum += r[j] * x[j];
+      result[i] = sum;
+    }
+  });
+  return result;
+}
+
+// y^T * m, accumulated row by row so the inner loop is contiguous
+static std::vector<double> multiply(const std::vector<double> &y,
+                                    const Matrix &m) {
+  const int n = m.getCols();
+  std::vector<double> result(n, 0.0);
+  for (int i = 0; i < m.getRows(); i++) {
+    if (y[i] == 0.0)
+      continue;
+    const double *r = m.rowPtr(i);
+    for (int j = 0; j < n; j++)
+      result[j] += y[i] * r[j];
+  }
+  return result;
+}
+
+// Updates
+
+bool IncrementalInverse::needsRefactor(double denominator) const {
+  return singular || !(std::abs(denominator) >= MIN_DENOMINATOR) ||
+         updatesSinceRefactor + 1 >= size();
+}
+
+void IncrementalInverse::update(const std::vector<double> &w,
+                                const std::vector<double> &z,
+                                double denominator) {
+  const int n = size();
+  ProfileScope profile(ProfileOp::RankOneUpdate, n, 2.0 * n * n);
+  double *base = inv.rowPtr(0);
+  const std::size_t ld = inv.getStride();
+  parallelRange(n, n, [&](int first, int last) {
+    for (int i = first; i < last; i++) {
+      const double factor = w[i] / denominator;
+      if (factor == 0.0)
+        continue;
+      double *r = base + i * ld;
+      for (int j = 0; j < n; j++)
+        r[j] -= factor * z[j];
+    }
+  });
+  det *= denominator;
+  updatesSinceRefactor++;
+}
+
+void IncrementalInverse::set(int i, int j, double value) {
+  const double delta = value - matrix.get(i, j); // checks the indices
+  if (delta == 0.0)
+    return;
+  matrix.set(i, j, value);
+  // u = delta e_i, v = e_j
+  const double denominator = singular ? 0.0 : 1.0 + delta * inv.rowPtr(j)[i];
+  if (needsRefactor(denominator)) {
+    refactor();
+    return;
+  }
+  std::vector<double> w = column(inv, i);
+  for (double &x : w)
+    x *= delta;
+  update(w, row(inv, j), denominator);
+}
+
+void IncrementalInverse::setRow(int i, const std::vector<double> &values) {
+  const int n = size();
+  if (i < 0 || i >= n) {
+    throw std::out_of_range("Row index out of range");
+  }
+  checkLength(values, n);
+  // u = e_i, v = values - row i
+  std::vector<double> v(n);
+  double *r = matrix.rowPtr(i);
+  for (int j = 0; j < n; j++) {
+    v[j] = values[j] - r[j];
+    r[j] = values[j];
+  }
+  if (singular) {
+    refactor();
+    return;
+  }
+  std::vector<double> z = multiply(v, inv);
+  const double denominator = 1.0 + z[i];
+  if (needsRefactor(denominator)) {
+    refactor();
+    return;
+  }
+  update(column(inv, i), z, denominator);
+}
+
+void IncrementalInverse::setCol(int j, const std::vector<double> &values) {
+  const int n = size();
+  if (j < 0 || j >= n) {
+    throw std::out_of_range("Column index out of range");
+  }
+  checkLength(values, n);
+  // u = values - column j, v = e_j
+  std::vector<double> u(n);
+  double *base = matrix.rowPtr(0);
+  const std::size_t ld = matrix.getStride();
+  for (int i = 0; i < n; i++) {
+    u[i] = values[i] - base[i * ld + j];
+    base[i * ld + j] = values[i];
+  }
+  if (singular) {
+    refactor();
+    return;
+  }
+  std::vector<double> w = multiply(inv, u);
+  const double denominator = 1.0 + w[j];
+  if (needsRefactor(denominator)) {
+    refactor();
+    return;
+  }
+  update(w, row(inv, j), denominator);
+}
+
+void IncrementalInverse::rankOneUpdate(const std::vector<double> &u,
+                                       const std::vector<double> &v) {
+  const int n = size();
+  checkLength(u, n);
+  checkLength(v, n);
+  double *base = matrix.rowPtr(0);
+  const std::size_t ld = matrix.getStride();
+  for (int i = 0; i < n; i++) {
+    if (u[i] == 0.0)
+      continue;
+    double *r = base + i * ld;
+    for (int j = 0; j < n; j++)
+      r[j] += u[i] * v[j];
+  }
+  if (singular) {
+    refactor();
+    return;
+  }
+  std::vector<double> w = multiply(inv, u);
+  double denominator = 1.0;
+  for (int i = 0; i < n; i++)
+    denominator += v[i] * w[i];
+  if (needsRefactor(denominator)) {
+    refactor();
+    return;
+  }
+  update(w, multiply(v, inv), denominator);
+}
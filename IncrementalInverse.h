@@ -0,0 +1,64 @@
+#ifndef INCREMENTAL_INVERSE_H
+#define INCREMENTAL_INVERSE_H
+
+#include "Matrix.h"
+#include <vector>
+
+// A square matrix together with its inverse and determinant, kept up to
+// date as single entries, rows or columns change.
+//
+// Every change is a rank-1 update A' = A + u v^T, applied in O(n^2) with
+// the Sherman-Morrison formula
+//
+//   A'^-1 = A^-1 - (A^-1 u)(v^T A^-1) / (1 + v^T A^-1 u)
+//
+// and the matrix determinant lemma det(A') = det(A) (1 + v^T A^-1 u),
+// instead of the O(n^3) of refactoring. Rounding errors of the updates
+// accumulate, so the inverse is recomputed from an LU factorization after
+// every size() updates (which keeps the amortized cost O(n^2)), and
+// whenever 1 + v^T A^-1 u falls below MIN_DENOMINATOR in magnitude: the
+// change then nearly makes A singular, and the formula would lose most of
+// its significant digits to cancellation.
+class IncrementalInverse {
+private:
+  Matrix matrix;
+  Matrix inv;
+  double det;
+  bool singular;
+  int updatesSinceRefactor;
+  int refactorCount;
+
+  // A += u v^T, given w = A^-1 u, z = v^T A^-1 and 1 + v^T A^-1 u
+  void update(const std::vector<double> &w, const std::vector<double> &z,
+              double denominator);
+  bool needsRefactor(double denominator) const;
+
+public:
+  static constexpr double MIN_DENOMINATOR = 1e-8;
+
+  // Factors A once. Throws std::invalid_argument unless A is square.
+  explicit IncrementalInverse(const Matrix &A);
+
+  int size() const { return matrix.getRows(); }
+  const Matrix &getMatrix() const { return matrix; }
+  // Throws std::runtime_error if the matrix is currently singular
+  const Matrix &inverse() const;
+  double determinant() const { return det; }
+  bool isSingular() const { return singular; }
+  // Full factorizations so far, including the initial one
+  int getRefactorCount() const { return refactorCount; }
+
+  // A(i, j) = value
+  void set(int i, int j, double value);
+  // Row i or column j of A = values
+  void setRow(int i, const std::vector<double> &values);
+  void setCol(int j, const std::vector<double> &values);
+  // A += u v^T
+  void rankOneUpdate(const std::vector<double> &u,
+                     const std::vector<double> &v);
+
+  // Recomputes the inverse and determinant from an LU factorization
+  void refactor();
+};
+
+#endif
@@ -0,0 +1,124 @@
+#include "LUDecomposition.h"
+#include "TriangularSolve.h"
+#include <algorithm>
+#include <cmath>
+
+// Right-looking elimination. Each update is a contiguous row operation, so
+// the inner loop streams through memory.
+LUDecomposition::LUDecomposition(const Matrix &A)
+    : lu(A.view()), perm(A.getRows()), sign(1), singular(false) {
+  if (!A.isSquare()) {
+    throw std::invalid_argument("LU decomposition requires a square matrix");
+  }
+  const int n = lu.getRows();
+  for (int i = 0; i < n; i++)
+    perm[i] = i;
+
+  double *a = lu.rowPtr(0);
+  const std::size_t ld = lu.getStride();
+  for (int k = 0; k < n; k++) {
+    int p = k;
+    double maxAbs = std::abs(a[k * ld + k]);
+    for (int i = k + 1; i < n; i++) {
+      double v = std::abs(a[i * ld + k]);
+      if (v > maxAbs) {
+        maxAbs = v;
+        p = i;
+      }
+    }
+    if (p != k) {
+      lu.swapRows(p, k);
+      std::swap(perm[p], perm[k]);
+      sign = -sign;
+    }
+    if (maxAbs < EPSILON)
+      singular = true;
+    if (maxAbs == 0.0)
+      continue;
+
+    const double *pivotRow = a + k * ld;
+    const double pivot = pivotRow[k];
+    for (int i = k + 1; i < n; i++) {
+      double *row = a + i * ld;
+      const double factor = row[k] / pivot;
+      row[k] = factor;
+      if (factor == 0.0)
+        continue;
+      for (int j = k + 1; j < n; j++) {
+        row[j] -= factor * pivotRow[j];
+      }
+    }
+  }
+}
+
+Matrix LUDecomposition::getL() const {
+  const int n = size();
+  Matrix L(n, n);
+  for (int i = 0; i < n; i++) {
+    std::copy(lu.rowPtr(i), lu.rowPtr(i) + i, L.rowPtr(i));
+    L.rowPtr(i)[i] = 1.0;
+  }
+  return L;
+}
+
+Matrix LUDecomposition::getU() const {
+  const int n = size();
+  Matrix U(n, n);
+  for (int i = 0; i < n; i++) {
+    std::copy(lu.rowPtr(i) + i, lu.rowPtr(i) + n, U.rowPtr(i) + i);
+  }
+  return U;
+}
+
+double LUDecomposition::determinant() const {
+  double det = sign;
+  for (int i = 0; i < size(); i++) {
+    det *= lu.rowPtr(i)[i];
+  }
+  return det == 0.0 ? 0.0 : det; // avoid printing -0
+}
+
+void LUDecomposition::solveInPlace(Matrix &x) const {
+  luSolveInPlace(size(), lu.rowPtr(0), lu.getStride(), x.rowPtr(0),
+                 x.getCols(), x.getStride());
+}
+
+Matrix LUDecomposition::inverse() const {
+  if (singular) {
+    throw std::runtime_error("Matrix is singular and cannot be inverted");
+  }
+  const int n = size();
+  Matrix x(n, n);
+  for (int i = 0; i < n; i++)
+    x.rowPtr(i)[perm[i]] = 1.0;
+  solveInPlace(x);
+  return x;
+}
+
+Matrix LUDecomposition::solve(const Matrix &B) const {
+  if (B.getRows() != size()) {
+    throw std::invalid_argument(
+        "Right-hand side must have as many rows as the matrix");
+  }
+  if (singular) {
+    throw std::runtime_error(
+        "Matrix is singular; the system has no unique solution");
+  }
+  const int m = B.getCols();
+  Matrix x(size(), m);
+  for (int i = 0; i < size(); i++)
+    std::copy(B.rowPtr(perm[i]), B.rowPtr(perm[i]) + m, x.rowPtr(i));
+  solveInPlace(x);
+  return x;
+}
+
+std::vector<double> LUDecomposition::solve(const std::vector<double> &b) const {
+  if (static_cast<int>(b.size()) != size()) {
+    throw std::invalid_argument(
+        "Right-hand side must have as many rows as the matrix");
+  }
+  Matrix B(size(), 1);
+  for (int i = 0; i < size(); i++)
+    B.rowPtr(i)[0] = b[i];
+  return solve(B).getColVector(0);
+}
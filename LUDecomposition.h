@@ -0,0 +1,36 @@
+#ifndef LU_DECOMPOSITION_H
+#define LU_DECOMPOSITION_H
+
+#include "Matrix.h"
+#include <vector>
+
+// LU factorization with partial pivoting: P * A = L * U.
+// L (unit lower) and U (upper) are packed into a single matrix.
+class LUDecomposition {
+private:
+  Matrix lu;
+  std::vector<int> perm; // row i of P * A is row perm[i] of A
+  int sign;              // parity of the permutation (+1 / -1)
+  bool singular;
+
+  void solveInPlace(Matrix &x) const;
+
+public:
+  explicit LUDecomposition(const Matrix &A);
+
+  int size() const { return lu.getRows(); }
+  bool isSingular() const { return singular; }
+  const std::vector<int> &getPermutation() const { return perm; }
+  Matrix getL() const;
+  Matrix getU() const;
+
+  double determinant() const;
+  Matrix inverse() const;
+
+  // Solves A * X = B for every column of B, reusing this factorization.
+  // Throws std::runtime_error if A is singular.
+  Matrix solve(const Matrix &B) const;
+  std::vector<double> solve(const std::vector<double> &b) const;
+};
+
+#endif
@@ -1,33 +1,172 @@
 #include "Matrix.h"
+#include "Gemm.h"
+#include "LUDecomposition.h"
+#include "MatrixArena.h"
+#include "Profiler.h"
+#include "QRDecomposition.h"
+#include "ThreadPool.h"
 #include <cmath>
 #include <iomanip>
 
-const double EPSILON = 1e-9;
+// Tile edge used by cache-friendly loops (transpose)
+const int BLOCK_SIZE = 32;
 
-// Constructors
-Matrix::Matrix() : rows(1), cols(1) {
-  data.resize(1, std::vector<double>(1, 0.0));
+// Everything derived from the reduced row echelon form
+struct EliminationResult {
+  Matrix rref;
+  int rank;
+  std::vector<int> pivotColumns;
+};
+
+// Storage allocated for new matrices, for the profiler
+static void profileStorage(std::size_t elements) {
+  if (Profiler::enabled())
+    Profiler::addAllocation(elements * sizeof(double));
 }
 
-Matrix::Matrix(int r, int c) : rows(r), cols(c) {
-  if (r > MAX_SIZE || c > MAX_SIZE || r < 1 || c < 1) {
-    throw std::invalid_argument("Matrix dimensions must be between 1 and " +
-                                std::to_string(MAX_SIZE));
+// Constructors
+Matrix::Matrix()
+    : data(1, 0.0, MatrixResourceScope::current()), rows(1), cols(1),
+      stride(1), cached(false) {}
+
+Matrix::Matrix(int r, int c) : Matrix(r, c, MatrixResourceScope::current()) {}
+
+Matrix::Matrix(int r, int c, std::pmr::memory_resource *resource)
+    : data(resource), rows(r), cols(c), stride(c), cached(false) {
+  if (r < 1 || c < 1) {
+    throw std::invalid_argument("Matrix dimensions must be positive");
   }
-  data.resize(rows, std::vector<double>(cols, 0.0));
+  data.resize(std::size_t(rows) * stride, 0.0);
+  profileStorage(data.size());
 }
 
-Matrix::Matrix(const std::vector<std::vector<double>> &values) {
-  if (values.empty()) {
+Matrix::Matrix(const std::vector<std::vector<double>> &values)
+    : data(MatrixResourceScope::current()), cached(false) {
+  if (values.empty() || values[0].empty()) {
     throw std::invalid_argument("Cannot create matrix from empty vector");
   }
   rows = values.size();
   cols = values[0].size();
-  if (rows > MAX_SIZE || cols > MAX_SIZE) {
-    throw std::invalid_argument("Matrix dimensions exceed maximum size of " +
-                                std::to_string(MAX_SIZE));
+  stride = cols;
+  data.resize(std::size_t(rows) * stride);
+  profileStorage(data.size());
+  for (int i = 0; i < rows; i++) {
+    if (static_cast<int>(values[i].size()) != cols) {
+      throw std::invalid_argument("All matrix rows must have the same length");
+    }
+    std::copy(values[i].begin(), values[i].end(), rowPtr(i));
+  }
+}
+
+Matrix::Matrix(const MatrixView &view)
+    : Matrix(view.getRows(), view.getCols()) {
+  for (int i = 0; i < rows; i++) {
+    std::copy(view.rowPtr(i), view.rowPtr(i) + cols, rowPtr(i));
+  }
+}
+
+Matrix::Matrix(const Matrix &other)
+    : data(other.data, MatrixResourceScope::current()), rows(other.rows),
+      cols(other.cols), stride(other.stride), cached(false) {
+  profileStorage(data.size());
+  shareCaches(other);
+}
+
+Matrix::Matrix(Matrix &&other) noexcept
+    : data(std::move(other.data)), rows(other.rows), cols(other.cols),
+      stride(other.stride), eliminationCache(std::move(other.eliminationCache)),
+      luCache(std::move(other.luCache)),
+      cached(other.cached.load(std::memory_order_relaxed)) {}
+
+Matrix &Matrix::operator=(const Matrix &other) {
+  if (this != &other) {
+    data = other.data;
+    rows = other.rows;
+    cols = other.cols;
+    stride = other.stride;
+    shareCaches(other);
+  }
+  return *this;
+}
+
+// Moving between different resources copies the elements (pmr allocators
+// do not propagate); the caches are on the heap and move either way
+Matrix &Matrix::operator=(Matrix &&other) {
+  if (this != &other) {
+    data = std::move(other.data);
+    rows = other.rows;
+    cols = other.cols;
+    stride = other.stride;
+    eliminationCache = std::move(other.eliminationCache);
+    luCache = std::move(other.luCache);
+    cached.store(other.cached.load(std::memory_order_relaxed),
+                 std::memory_order_relaxed);
+  }
+  return *this;
+}
+
+// Cached properties
+
+void Matrix::dropCaches() {
+  cached.store(false, std::memory_order_relaxed);
+  std::atomic_store(&eliminationCache,
+                    std::shared_ptr<const EliminationResult>());
+  std::atomic_store(&luCache, std::shared_ptr<const LUDecomposition>());
+}
+
+void Matrix::shareCaches(const Matrix &other) {
+  std::atomic_store(&eliminationCache,
+                    std::atomic_load(&other.eliminationCache));
+  std::atomic_store(&luCache, std::atomic_load(&other.luCache));
+  cached.store(other.cached.load(std::memory_order_relaxed),
+               std::memory_order_relaxed);
+}
+
+// Two threads asking at once may both compute; either result is correct.
+// Results are built on the heap whatever this matrix's resource is: const
+// queries may come from any thread, and an arena's pool is not
+// synchronized (the cache also outlives the arena that way).
+std::shared_ptr<const EliminationResult> Matrix::elimination() const {
+  std::shared_ptr<const EliminationResult> result =
+      std::atomic_load(&eliminationCache);
+  if (result)
+    return result;
+  MatrixResourceScope scope(std::pmr::new_delete_resource());
+  Matrix reduced = computeRref();
+  std::vector<int> pivots;
+  for (int i = 0; i < rows; i++) {
+    const double *row = reduced.view().rowPtr(i);
+    const double *lead = std::find_if(
+        row, row + cols, [](double v) { return std::abs(v) > EPSILON; });
+    if (lead == row + cols)
+      break;
+    pivots.push_back(static_cast<int>(lead - row));
   }
-  data = values;
+  const int rnk = static_cast<int>(pivots.size());
+  result = std::make_shared<const EliminationResult>(
+      EliminationResult{std::move(reduced), rnk, std::move(pivots)});
+  std::atomic_store(&eliminationCache, result);
+  cached.store(true, std::memory_order_relaxed);
+  return result;
+}
+
+std::shared_ptr<const LUDecomposition> Matrix::luFactorization() const {
+  std::shared_ptr<const LUDecomposition> result = std::atomic_load(&luCache);
+  if (result)
+    return result;
+  MatrixResourceScope scope(std::pmr::new_delete_resource());
+  ProfileScope profile(ProfileOp::LUFactorization, rows,
+                       2.0 * rows * rows * rows / 3.0);
+  result = std::make_shared<const LUDecomposition>(*this);
+  std::atomic_store(&luCache, result);
+  cached.store(true, std::memory_order_relaxed);
+  return result;
+}
+
+int Matrix::rank() const { return elimination()->rank; }
+
+std::vector<int> Matrix::pivotColumns() const {
+  return elimination()->pivotColumns;
 }
 
 // Getters and Setters
@@ -35,24 +174,25 @@ double Matrix::get(int i, int j) const {
   if (i < 0 || i >= rows || j < 0 || j >= cols) {
     throw std::out_of_range("Matrix indices out of range");
   }
-  return data[i][j];
+  return rowPtr(i)[j];
 }
 
 void Matrix::set(int i, int j, double value) {
   if (i < 0 || i >= rows || j < 0 || j >= cols) {
     throw std::out_of_range("Matrix indices out of range");
   }
-  data[i][j] = value;
+  rowPtr(i)[j] = value;
 }
 
 // Display
 void Matrix::display() const {
   std::cout << "\n";
   for (int i = 0; i < rows; i++) {
+    const double *row = rowPtr(i);
     std::cout << "  [ ";
     for (int j = 0; j < cols; j++) {
       std::cout << std::setw(10) << std::fixed << std::setprecision(4)
-                << data[i][j];
+                << row[j];
       if (j < cols - 1)
         std::cout << "  ";
     }
@@ -62,109 +202,239 @@ void Matrix::display() const {
 }
 
 // Basic Operations
-Matrix Matrix::operator+(const Matrix &other) const {
-  if (rows != other.rows || cols != other.cols) {
-    throw std::invalid_argument("Matrix dimensions must match for addition");
-  }
-  Matrix result(rows, cols);
-  for (int i = 0; i < rows; i++) {
-    for (int j = 0; j < cols; j++) {
-      result.data[i][j] = data[i][j] + other.data[i][j];
-    }
-  }
-  return result;
+Matrix Matrix::operator*(const Matrix &other) const {
+  return multiply(view(), other.view());
 }
 
-Matrix Matrix::operator-(const Matrix &other) const {
-  if (rows != other.rows || cols != other.cols) {
-    throw std::invalid_argument("Matrix dimensions must match for subtraction");
-  }
-  Matrix result(rows, cols);
-  for (int i = 0; i < rows; i++) {
-    for (int j = 0; j < cols; j++) {
-      result.data[i][j] = data[i][j] - other.data[i][j];
-    }
+Matrix Matrix::multiply(const MatrixView &a, const MatrixView &b) {
+  if (a.getCols() != b.getRows()) {
+    throw std::invalid_argument("Invalid dimensions for matrix multiplication");
   }
+  ProfileScope profile(
+      ProfileOp::Multiply,
+      std::max({a.getRows(), a.getCols(), b.getCols()}),
+      2.0 * a.getRows() * a.getCols() * b.getCols());
+  Matrix result(a.getRows(), b.getCols());
+  gemm(a.getRows(), b.getCols(), a.getCols(), a.data(), a.getStride(),
+       b.data(), b.getStride(), result.rowPtr(0), result.stride);
   return result;
 }
 
-Matrix Matrix::operator*(const Matrix &other) const {
-  if (cols != other.rows) {
-    throw std::invalid_argument("Invalid dimensions for matrix multiplication");
-  }
-  Matrix result(rows, other.cols);
-  for (int i = 0; i < rows; i++) {
-    for (int j = 0; j < other.cols; j++) {
-      double sum = 0.0;
-      for (int k = 0; k < cols; k++) {
-        sum += data[i][k] * other.data[k][j];
+// Tiled so both the reads and the writes stay within a few cache lines;
+// each horizontal strip of tiles writes its own columns of the output
+static void transposeInto(const MatrixView &src, double *out,
+                          std::size_t ld) {
+  const int rows = src.getRows();
+  const int cols = src.getCols();
+  const int strips = (rows + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  parallelRange(strips, 1LL * BLOCK_SIZE * cols, [&](int first, int last) {
+    for (int ii = first * BLOCK_SIZE; ii < std::min(last * BLOCK_SIZE, rows);
+         ii += BLOCK_SIZE) {
+      const int iEnd = std::min(ii + BLOCK_SIZE, rows);
+      for (int jj = 0; jj < cols; jj += BLOCK_SIZE) {
+        const int jEnd = std::min(jj + BLOCK_SIZE, cols);
+        for (int i = ii; i < iEnd; i++) {
+          const double *row = src.rowPtr(i);
+          for (int j = jj; j < jEnd; j++) {
+            out[j * ld + i] = row[j];
+          }
+        }
       }
-      result.data[i][j] = sum;
     }
-  }
+  });
+}
+
+// Per-thread buffer for operations that cannot write their result over
+// their input; it only grows, so steady-state loops do not allocate
+static double *scratchBuffer(std::size_t size) {
+  static thread_local std::vector<double> scratch;
+  if (scratch.size() < size)
+    scratch.resize(size);
+  return scratch.data();
+}
+
+Matrix Matrix::transpose() const & {
+  ProfileScope profile(ProfileOp::Transpose, std::max(rows, cols));
+  Matrix result(cols, rows);
+  transposeInto(view(), result.rowPtr(0), result.stride);
   return result;
 }
 
-Matrix Matrix::operator*(double scalar) const {
-  Matrix result(rows, cols);
-  for (int i = 0; i < rows; i++) {
-    for (int j = 0; j < cols; j++) {
-      result.data[i][j] = data[i][j] * scalar;
-    }
+Matrix Matrix::transpose() && {
+  transposeInPlace();
+  return std::move(*this);
+}
+
+void Matrix::transposeInPlace() {
+  ProfileScope profile(ProfileOp::Transpose, std::max(rows, cols));
+  invalidate();
+  double *a = data.data();
+  const std::size_t ld = stride;
+  if (rows == cols) {
+    // Swap tile (ii, jj) with tile (jj, ii); strip ii owns every tile pair
+    // with jj >= ii, so strips never touch the same elements
+    const int strips = (rows + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    parallelRange(strips, 1LL * BLOCK_SIZE * cols / 2, [&](int first,
+                                                          int last) {
+      for (int s = first; s < last; s++) {
+        const int ii = s * BLOCK_SIZE;
+        const int iEnd = std::min(ii + BLOCK_SIZE, rows);
+        for (int jj = ii; jj < cols; jj += BLOCK_SIZE) {
+          const int jEnd = std::min(jj + BLOCK_SIZE, cols);
+          for (int i = ii; i < iEnd; i++) {
+            for (int j = std::max(jj, i + 1); j < jEnd; j++)
+              std::swap(a[i * ld + j], a[j * ld + i]);
+          }
+        }
+      }
+    });
+    return;
   }
-  return result;
+  const std::size_t size = std::size_t(rows) * cols;
+  double *tmp = scratchBuffer(size);
+  transposeInto(view(), tmp, rows);
+  std::swap(rows, cols);
+  stride = cols;
+  data.resize(size);
+  std::copy(tmp, tmp + size, data.begin());
 }
 
-Matrix Matrix::transpose() const {
-  Matrix result(cols, rows);
-  for (int i = 0; i < rows; i++) {
-    for (int j = 0; j < cols; j++) {
-      result.data[j][i] = data[i][j];
-    }
+// In-place Operations
+
+Matrix &Matrix::operator+=(const Matrix &other) {
+  return *this = *this + other;
+}
+
+Matrix &Matrix::operator-=(const Matrix &other) {
+  return *this = *this - other;
+}
+
+Matrix &Matrix::operator*=(double scalar) { return *this = *this * scalar; }
+
+// The product goes to the scratch buffer first: gemm cannot overwrite an
+// operand it is still reading
+Matrix &Matrix::operator*=(const Matrix &other) {
+  if (cols != other.rows) {
+    throw std::invalid_argument("Invalid dimensions for matrix multiplication");
   }
-  return result;
+  ProfileScope profile(ProfileOp::Multiply,
+                       std::max({rows, cols, other.cols}),
+                       2.0 * rows * cols * other.cols);
+  const int n = other.cols;
+  const std::size_t size = std::size_t(rows) * n;
+  double *tmp = scratchBuffer(size);
+  std::fill(tmp, tmp + size, 0.0);
+  gemm(rows, n, cols, view().data(), stride, other.view().data(),
+       other.stride, tmp, n);
+  invalidate();
+  cols = n;
+  stride = n;
+  data.resize(size);
+  std::copy(tmp, tmp + size, data.begin());
+  return *this;
+}
+
+Matrix operator+(Matrix &&lhs, const Matrix &rhs) {
+  lhs += rhs;
+  return std::move(lhs);
+}
+
+Matrix operator+(const Matrix &lhs, Matrix &&rhs) {
+  rhs += lhs;
+  return std::move(rhs);
+}
+
+Matrix operator+(Matrix &&lhs, Matrix &&rhs) {
+  lhs += rhs;
+  return std::move(lhs);
+}
+
+Matrix operator-(Matrix &&lhs, const Matrix &rhs) {
+  lhs -= rhs;
+  return std::move(lhs);
+}
+
+Matrix operator-(const Matrix &lhs, Matrix &&rhs) {
+  rhs = lhs - rhs;
+  return std::move(rhs);
+}
+
+Matrix operator-(Matrix &&lhs, Matrix &&rhs) {
+  lhs -= rhs;
+  return std::move(lhs);
+}
+
+Matrix operator*(Matrix &&lhs, double scalar) {
+  lhs *= scalar;
+  return std::move(lhs);
+}
+
+Matrix operator*(double scalar, Matrix &&rhs) {
+  rhs *= scalar;
+  return std::move(rhs);
 }
 
 // Helper Methods
-void Matrix::swapRows(int i, int j) { std::swap(data[i], data[j]); }
+void Matrix::swapRows(int i, int j) {
+  if (i == j)
+    return;
+  std::swap_ranges(rowPtr(i), rowPtr(i) + cols, rowPtr(j));
+}
 
 void Matrix::multiplyRow(int i, double scalar) {
+  double *row = rowPtr(i);
   for (int j = 0; j < cols; j++) {
-    data[i][j] *= scalar;
+    row[j] *= scalar;
   }
 }
 
 void Matrix::addMultipleOfRow(int target, int source, double scalar) {
+  double *dst = rowPtr(target);
+  const double *src = rowPtr(source);
   for (int j = 0; j < cols; j++) {
-    data[target][j] += scalar * data[source][j];
+    dst[j] += scalar * src[j];
   }
 }
 
 Matrix Matrix::getSubmatrix(int excludeRow, int excludeCol) const {
+  ProfileScope profile(ProfileOp::Submatrix, std::max(rows, cols));
   Matrix result(rows - 1, cols - 1);
   int r = 0;
   for (int i = 0; i < rows; i++) {
     if (i == excludeRow)
       continue;
-    int c = 0;
-    for (int j = 0; j < cols; j++) {
-      if (j == excludeCol)
-        continue;
-      result.data[r][c] = data[i][j];
-      c++;
-    }
+    const double *src = rowPtr(i);
+    double *out = result.rowPtr(r);
+    std::copy(src, src + excludeCol, out);
+    std::copy(src + excludeCol + 1, src + cols, out + excludeCol);
     r++;
   }
   return result;
 }
 
 // RREF (Reduced Row Echelon Form)
-Matrix Matrix::rref() const {
-  Matrix result = *this;
+Matrix Matrix::rref() const & { return elimination()->rref; }
+
+Matrix Matrix::rref() && {
+  rrefInPlace();
+  return std::move(*this);
+}
+
+Matrix Matrix::computeRref() const {
+  Matrix result(view());
+  result.rrefInPlace();
+  return result;
+}
+
+// Nominal flop count: one multiply-add per element and pivot
+void Matrix::rrefInPlace() {
+  ProfileScope profile(ProfileOp::Rref, std::max(rows, cols),
+                       2.0 * rows * cols * std::min(rows, cols));
+  invalidate();
   int lead = 0;
   for (int r = 0; r < rows && lead < cols; r++) {
     int i = r;
-    while (i < rows && std::abs(result.data[i][lead]) < EPSILON) {
+    while (i < rows && std::abs(rowPtr(i)[lead]) < EPSILON) {
       i++;
     }
     if (i == rows) {
@@ -173,46 +443,42 @@ Matrix Matrix::rref() const {
       continue;
     }
     if (i != r) {
-      result.swapRows(r, i);
+      swapRows(r, i);
     }
-    double pivot = result.data[r][lead];
+    double pivot = rowPtr(r)[lead];
     if (std::abs(pivot) > EPSILON) {
-      result.multiplyRow(r, 1.0 / pivot);
+      multiplyRow(r, 1.0 / pivot);
     }
-    for (int i = 0; i < rows; i++) {
-      if (i != r) {
-        double factor = result.data[i][lead];
-        result.addMultipleOfRow(i, r, -factor);
+    // Rows are independent once the pivot row is fixed
+    parallelRange(rows, cols, [&](int first, int last) {
+      for (int i = first; i < last; i++) {
+        if (i != r) {
+          double factor = rowPtr(i)[lead];
+          if (factor != 0.0)
+            addMultipleOfRow(i, r, -factor);
+        }
       }
-    }
+    });
     lead++;
   }
-  for (int i = 0; i < rows; i++) {
-    for (int j = 0; j < cols; j++) {
-      if (std::abs(result.data[i][j]) < EPSILON)
-        result.data[i][j] = 0.0;
-    }
+  for (double &value : data) {
+    if (std::abs(value) < EPSILON)
+      value = 0.0;
   }
-  return result;
 }
 
-// Determinant
+// Determinant (product of the LU pivots, O(n^3))
 double Matrix::determinant() const {
   if (!isSquare()) {
     throw std::invalid_argument(
         "Determinant is only defined for square matrices");
   }
+  ProfileScope profile(ProfileOp::Determinant, rows);
   if (rows == 1)
-    return data[0][0];
+    return rowPtr(0)[0];
   if (rows == 2)
-    return data[0][0] * data[1][1] - data[0][1] * data[1][0];
-  double det = 0.0;
-  for (int j = 0; j < cols; j++) {
-    Matrix submatrix = getSubmatrix(0, j);
-    double cofactor = data[0][j] * submatrix.determinant();
-    det += (j % 2 == 0) ? cofactor : -cofactor;
-  }
-  return det;
+    return rowPtr(0)[0] * rowPtr(1)[1] - rowPtr(0)[1] * rowPtr(1)[0];
+  return luFactorization()->determinant();
 }
 
 // Trace
@@ -222,64 +488,55 @@ double Matrix::trace() const {
   }
   double tr = 0.0;
   for (int i = 0; i < rows; i++) {
-    tr += data[i][i];
+    tr += rowPtr(i)[i];
   }
   return tr;
 }
 
-// Inverse
+// Inverse (solved from the same LU factors used for the determinant)
 Matrix Matrix::inverse() const {
   if (!isSquare()) {
     throw std::invalid_argument("Only square matrices can be inverted");
   }
-  double det = determinant();
-  if (std::abs(det) < EPSILON) {
+  ProfileScope profile(ProfileOp::Inverse, rows,
+                       4.0 * rows * rows * rows / 3.0);
+  std::shared_ptr<const LUDecomposition> lu = luFactorization();
+  if (lu->isSingular()) {
     throw std::runtime_error("Matrix is singular and cannot be inverted");
   }
-  Matrix augmented(rows, 2 * cols);
-  for (int i = 0; i < rows; i++) {
-    for (int j = 0; j < cols; j++) {
-      augmented.data[i][j] = data[i][j];
-      augmented.data[i][j + cols] = (i == j) ? 1.0 : 0.0;
-    }
-  }
-  augmented = augmented.rref();
-  Matrix result(rows, cols);
-  for (int i = 0; i < rows; i++) {
-    for (int j = 0; j < cols; j++) {
-      result.data[i][j] = augmented.data[i][j + cols];
-    }
+  return lu->inverse();
+}
+
+Matrix Matrix::solve(const Matrix &A, const Matrix &B) {
+  if (!A.isSquare()) {
+    throw std::invalid_argument("Only square systems can be solved");
   }
-  return result;
+  ProfileScope profile(ProfileOp::Solve, std::max(A.rows, B.cols),
+                       2.0 * A.rows * A.rows * B.cols);
+  return A.luFactorization()->solve(B);
 }
 
-// Gram-Schmidt
+// Gram-Schmidt orthonormalization of the columns, computed with blocked
+// Householder QR. Column j of the result is the unit vector along the part
+// of column j orthogonal to the columns before it, or zero when that part
+// has norm^2 <= EPSILON (same convention as classical Gram-Schmidt, but
+// orthogonal to working precision).
 Matrix Matrix::gramSchmidt() const {
+  const double k = std::min(rows, cols);
+  ProfileScope profile(ProfileOp::GramSchmidt, std::max(rows, cols),
+                       4.0 * rows * cols * k - 4.0 * k * k * k / 3.0);
   Matrix result(rows, cols);
-  for (int j = 0; j < cols; j++) {
-    std::vector<double> v(rows);
+  QRDecomposition qr(*this, EPSILON);
+  if (qr.size() == 0)
+    return result;
+  const Matrix Q = qr.getQ();
+  const Matrix R = qr.getR();
+  const std::vector<int> &pivots = qr.getPivotColumns();
+  for (int t = 0; t < qr.size(); t++) {
+    const int j = pivots[t];
+    const double sign = R.rowPtr(t)[j] < 0.0 ? -1.0 : 1.0;
     for (int i = 0; i < rows; i++)
-      v[i] = data[i][j];
-    for (int k = 0; k < j; k++) {
-      double dotVU = 0.0, dotUU = 0.0;
-      for (int i = 0; i < rows; i++) {
-        dotVU += v[i] * result.data[i][k];
-        dotUU += result.data[i][k] * result.data[i][k];
-      }
-      if (dotUU > EPSILON) {
-        double proj = dotVU / dotUU;
-        for (int i = 0; i < rows; i++)
-          v[i] -= proj * result.data[i][k];
-      }
-    }
-    double normSq = 0.0;
-    for (int i = 0; i < rows; i++)
-      normSq += v[i] * v[i];
-    if (normSq > EPSILON) {
-      double norm = std::sqrt(normSq);
-      for (int i = 0; i < rows; i++)
-        result.data[i][j] = v[i] / norm;
-    }
+      result.rowPtr(i)[j] = sign * Q.rowPtr(i)[t];
   }
   return result;
 }
@@ -288,8 +545,9 @@ bool Matrix::isSymmetric() const {
   if (!isSquare())
     return false;
   for (int i = 0; i < rows; i++) {
+    const double *row = rowPtr(i);
     for (int j = i + 1; j < cols; j++) {
-      if (std::abs(data[i][j] - data[j][i]) > EPSILON)
+      if (std::abs(row[j] - rowPtr(j)[i]) > EPSILON)
         return false;
     }
   }
@@ -297,65 +555,34 @@ bool Matrix::isSymmetric() const {
 }
 
 bool Matrix::isLinearlyIndependent() const {
-  Matrix r = rref();
-  int rnk = 0;
-  for (int i = 0; i < rows; i++) {
-    bool allZero = true;
-    for (int j = 0; j < cols; j++) {
-      if (std::abs(r.data[i][j]) > EPSILON) {
-        allZero = false;
-        break;
-      }
-    }
-    if (!allZero)
-      rnk++;
-  }
-  return rnk == std::min(rows, cols);
+  return rank() == std::min(rows, cols);
 }
 
+// The first rank() rows: the nonzero rows of the rref come first
 std::vector<std::vector<double>> Matrix::basis() const {
-  Matrix rref_form = rref();
   std::vector<std::vector<double>> basis;
-  for (int i = 0; i < rows; i++) {
-    bool allZero = true;
-    for (int j = 0; j < cols; j++) {
-      if (std::abs(rref_form.data[i][j]) > EPSILON) {
-        allZero = false;
-        break;
-      }
-    }
-    if (!allZero) {
-      std::vector<double> row;
-      for (int j = 0; j < cols; j++)
-        row.push_back(data[i][j]);
-      basis.push_back(row);
-    }
+  const int rnk = rank();
+  for (int i = 0; i < rnk; i++) {
+    basis.push_back(getRowVector(i));
   }
   return basis;
 }
 
 Matrix Matrix::identity(int n) {
-  if (n > MAX_SIZE || n < 1)
+  if (n < 1)
     throw std::invalid_argument("Matrix size error");
   Matrix I(n, n);
   for (int i = 0; i < n; i++)
-    I.data[i][i] = 1.0;
+    I.rowPtr(i)[i] = 1.0;
   return I;
 }
 
 Matrix Matrix::zero(int r, int c) { return Matrix(r, c); }
 
 std::vector<double> Matrix::getRowVector(int i) const {
-  if (i < 0 || i >= rows)
-    throw std::out_of_range("Row index error");
-  return data[i];
+  return rowView(i).toVector();
 }
 
 std::vector<double> Matrix::getColVector(int j) const {
-  if (j < 0 || j >= cols)
-    throw std::out_of_range("Col index error");
-  std::vector<double> col;
-  for (int i = 0; i < rows; i++)
-    col.push_back(data[i][j]);
-  return col;
+  return colView(j).toVector();
 }
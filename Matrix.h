@@ -1,52 +1,139 @@
 #ifndef MATRIX_H
 #define MATRIX_H
 
+#include "MatrixView.h"
 #include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <memory_resource>
 #include <stdexcept>
 #include <vector>
 
-const int MAX_SIZE = 5;
+// Threshold below which a value is treated as zero
+constexpr double EPSILON = 1e-9;
+
+template <typename E> class MatrixExpr;
+class LUDecomposition;
+struct EliminationResult;
 
 class Matrix {
 private:
-  std::vector<std::vector<double>> data;
+  // Row-major contiguous storage: element (i, j) lives at data[i * stride + j]
+  // in a memory resource chosen at construction (see MatrixArena.h)
+  std::pmr::vector<double> data;
   int rows;
   int cols;
+  int stride; // leading dimension (distance between rows)
+
+  // Lazily computed properties, shared between copies and dropped by any
+  // mutation. They are allocated on the heap, never from the matrix's own
+  // resource, and the pointers are read and written atomically, so const
+  // queries may run concurrently; `cached` lets mutators skip the drop
+  // when there is nothing to release.
+  mutable std::shared_ptr<const EliminationResult> eliminationCache;
+  mutable std::shared_ptr<const LUDecomposition> luCache;
+  mutable std::atomic<bool> cached;
+
+  void invalidate() {
+    if (cached.load(std::memory_order_relaxed))
+      dropCaches();
+  }
+  void dropCaches();
+  void shareCaches(const Matrix &other);
+  std::shared_ptr<const EliminationResult> elimination() const;
+  Matrix computeRref() const;
+
+  template <typename E> void evaluate(const MatrixExpr<E> &expr);
 
 public:
   // Constructors
   Matrix();
   Matrix(int r, int c);
+  Matrix(int r, int c, std::pmr::memory_resource *resource);
   Matrix(const std::vector<std::vector<double>> &values);
+  explicit Matrix(const MatrixView &view); // copies the viewed elements
+  Matrix(const Matrix &other);
+  // Takes over other's storage, and with it other's memory resource: a
+  // matrix moved out of a MatrixArena scope still points into the arena
+  Matrix(Matrix &&other) noexcept;
+  Matrix &operator=(const Matrix &other);
+  // Keeps this matrix's resource. If other uses a different one, the
+  // elements are copied, which can throw std::bad_alloc.
+  Matrix &operator=(Matrix &&other);
+
+  // Evaluate a lazy element-wise expression such as A + B - C * 2.0 in a
+  // single pass (see MatrixExpr.h)
+  template <typename E> Matrix(const MatrixExpr<E> &expr);
+  template <typename E> Matrix &operator=(const MatrixExpr<E> &expr);
 
   // Getters
   int getRows() const { return rows; }
   int getCols() const { return cols; }
+  int getStride() const { return stride; }
+  std::pmr::memory_resource *getResource() const {
+    return data.get_allocator().resource();
+  }
   double get(int i, int j) const;
   void set(int i, int j, double value);
 
+  // Raw row-major access (no bounds checks). The non-const overload counts
+  // as a mutation and drops cached properties.
+  double *rowPtr(int i) {
+    invalidate();
+    return data.data() + std::size_t(i) * stride;
+  }
+  const double *rowPtr(int i) const {
+    return data.data() + std::size_t(i) * stride;
+  }
+
+  // Zero-copy views (valid while this matrix is alive and not resized)
+  MatrixView view() const {
+    return MatrixView(rowPtr(0), rows, cols, stride);
+  }
+  operator MatrixView() const { return view(); }
+  VectorView rowView(int i) const { return view().row(i); }
+  VectorView colView(int j) const { return view().col(j); }
+  MatrixView blockView(int row0, int col0, int nRows, int nCols) const {
+    return view().block(row0, col0, nRows, nCols);
+  }
+
   // Display
   void display() const;
 
-  // Basic Operations
-  Matrix operator+(const Matrix &other) const;
-  Matrix operator-(const Matrix &other) const;
+  // Basic Operations (+, - and scalar * are lazy, see MatrixExpr.h)
   Matrix operator*(const Matrix &other) const;
-  Matrix operator*(double scalar) const;
-  Matrix transpose() const;
+  Matrix transpose() const &;
+  Matrix transpose() &&; // reuses the storage of an expiring matrix
+
+  // In-place operations. None of them allocate once the matrix (and, for
+  // reshaping ones, the per-thread scratch buffer) has reached its size.
+  Matrix &operator+=(const Matrix &other);
+  Matrix &operator-=(const Matrix &other);
+  template <typename E> Matrix &operator+=(const MatrixExpr<E> &expr);
+  template <typename E> Matrix &operator-=(const MatrixExpr<E> &expr);
+  Matrix &operator*=(double scalar);
+  Matrix &operator*=(const Matrix &other); // this = this * other
+  void transposeInPlace();
+  void rrefInPlace();
 
   // Advanced Operations
   double determinant() const;
   Matrix inverse() const;
-  Matrix rref() const;
+  Matrix rref() const &;
+  Matrix rref() &&;
   double trace() const;
 
   // Decompositions
   Matrix gramSchmidt() const;
 
-  // Properties
+  // Properties. rank, pivot columns, rref and the LU factorization are
+  // computed on first use and cached until the matrix is modified.
+  int rank() const;
+  std::vector<int> pivotColumns() const;
+  std::shared_ptr<const LUDecomposition> luFactorization() const;
   bool isSquare() const { return rows == cols; }
   bool isSymmetric() const;
   bool isLinearlyIndependent() const;
@@ -63,6 +150,24 @@ public:
   // Static methods
   static Matrix identity(int n);
   static Matrix zero(int r, int c);
+  // Product of two views (e.g. sub-blocks) without copying the operands
+  static Matrix multiply(const MatrixView &a, const MatrixView &b);
+  // Solves A * X = B (one column of X per column of B) with a pivoted LU
+  // factorization; use LUDecomposition directly to reuse it across calls
+  static Matrix solve(const Matrix &A, const Matrix &B);
 };
 
+// Element-wise operations with an expiring operand write the result into
+// that operand's storage instead of allocating a new matrix
+Matrix operator+(Matrix &&lhs, const Matrix &rhs);
+Matrix operator+(const Matrix &lhs, Matrix &&rhs);
+Matrix operator+(Matrix &&lhs, Matrix &&rhs);
+Matrix operator-(Matrix &&lhs, const Matrix &rhs);
+Matrix operator-(const Matrix &lhs, Matrix &&rhs);
+Matrix operator-(Matrix &&lhs, Matrix &&rhs);
+Matrix operator*(Matrix &&lhs, double scalar);
+Matrix operator*(double scalar, Matrix &&rhs);
+
+#include "MatrixExpr.h"
+
 #endif
@@ -0,0 +1,26 @@
+#include "MatrixArena.h"
+
+// Null means the process default (std::pmr::get_default_resource)
+static thread_local std::pmr::memory_resource *currentResource = nullptr;
+
+MatrixResourceScope::MatrixResourceScope(std::pmr::memory_resource *resource)
+    : previous(currentResource) {
+  currentResource = resource;
+}
+
+MatrixResourceScope::~MatrixResourceScope() { currentResource = previous; }
+
+std::pmr::memory_resource *MatrixResourceScope::current() {
+  return currentResource != nullptr ? currentResource
+                                    : std::pmr::get_default_resource();
+}
+
+static std::pmr::pool_options arenaOptions() {
+  std::pmr::pool_options options;
+  options.max_blocks_per_chunk = 0; // implementation default
+  options.largest_required_pool_block = MatrixArena::LARGEST_POOLED_BLOCK;
+  return options;
+}
+
+MatrixArena::MatrixArena(std::pmr::memory_resource *upstream)
+    : pool(arenaOptions(), upstream), scope(&pool) {}
@@ -0,0 +1,66 @@
+#ifndef MATRIX_ARENA_H
+#define MATRIX_ARENA_H
+
+#include <cstddef>
+#include <memory_resource>
+
+// Where Matrix storage comes from.
+//
+// A Matrix takes its elements from a std::pmr::memory_resource, which is
+// fixed when the matrix is constructed. It uses the resource passed to the
+// constructor if there is one, and otherwise the calling thread's current
+// resource (the global heap unless a scope below replaces it). Copies
+// follow the current resource, not the source's. Assigning into an
+// existing matrix keeps that matrix's resource. Move construction is the
+// exception: the new matrix takes over the source's storage as it is,
+// resource included.
+
+// Makes `resource` the calling thread's current resource for the lifetime
+// of the scope, then restores the previous one. Scopes nest.
+class MatrixResourceScope {
+private:
+  std::pmr::memory_resource *previous;
+
+public:
+  explicit MatrixResourceScope(std::pmr::memory_resource *resource);
+  ~MatrixResourceScope();
+  MatrixResourceScope(const MatrixResourceScope &) = delete;
+  MatrixResourceScope &operator=(const MatrixResourceScope &) = delete;
+
+  static std::pmr::memory_resource *current();
+};
+
+// Per-thread pool for the temporaries of one computation:
+//
+//   {
+//     MatrixArena arena;
+//     double d = (A * B - C).determinant();
+//   } // every block allocated in the scope is returned at once
+//
+// While the arena is alive, matrices created on this thread take their
+// storage from size-class pools that need no locking. Blocks freed in the
+// scope are reused by later matrices of a similar size. All memory goes
+// back to the upstream resource when the arena is destroyed or
+// release()d. A matrix created in the scope must not outlive the arena:
+// assign results to a matrix declared outside it (this copies them to
+// that matrix's resource) instead of moving-constructing them out.
+class MatrixArena {
+private:
+  std::pmr::unsynchronized_pool_resource pool;
+  MatrixResourceScope scope; // declared after pool, so it ends first
+
+public:
+  // Blocks up to this size are pooled; larger ones go to upstream
+  static const std::size_t LARGEST_POOLED_BLOCK = std::size_t(1) << 22;
+
+  explicit MatrixArena(
+      std::pmr::memory_resource *upstream = std::pmr::new_delete_resource());
+  MatrixArena(const MatrixArena &) = delete;
+  MatrixArena &operator=(const MatrixArena &) = delete;
+
+  std::pmr::memory_resource *resource() { return &pool; }
+  // Returns every block to upstream; no matrix from the arena may be alive
+  void release() { pool.release(); }
+};
+
+#endif
@@ -0,0 +1,276 @@
+#include "MatrixBatch.h"
+#include "ThreadPool.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+const int LANES = MatrixBatch::LANES;
+
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__ELF__)
+// Build the per-block kernels twice and let the loader pick the AVX2 copy
+// on CPUs that have it (the row helpers below are inlined into each copy)
+#define BATCH_KERNEL __attribute__((target_clones("avx2", "default")))
+#define BATCH_INLINE inline __attribute__((always_inline))
+#else
+#define BATCH_KERNEL
+#define BATCH_INLINE inline
+#endif
+
+MatrixBatch::MatrixBatch(int count, int rows, int cols)
+    : count(count), rows(rows), cols(cols),
+      blocks((count + LANES - 1) / LANES) {
+  if (count < 0 || rows < 1 || cols < 1) {
+    throw std::invalid_argument("Batch dimensions must be positive");
+  }
+  data.resize(std::size_t(blocks) * rows * cols * LANES, 0.0);
+}
+
+double MatrixBatch::get(int index, int i, int j) const {
+  if (index < 0 || index >= count || i < 0 || i >= rows || j < 0 || j >= cols) {
+    throw std::out_of_range("Batch indices out of range");
+  }
+  return data[offset(index, i, j)];
+}
+
+void MatrixBatch::set(int index, int i, int j, double value) {
+  if (index < 0 || index >= count || i < 0 || i >= rows || j < 0 || j >= cols) {
+    throw std::out_of_range("Batch indices out of range");
+  }
+  data[offset(index, i, j)] = value;
+}
+
+Matrix MatrixBatch::getMatrix(int index) const {
+  if (index < 0 || index >= count) {
+    throw std::out_of_range("Batch index out of range");
+  }
+  Matrix m(rows, cols);
+  for (int i = 0; i < rows; i++)
+    for (int j = 0; j < cols; j++)
+      m.rowPtr(i)[j] = data[offset(index, i, j)];
+  return m;
+}
+
+void MatrixBatch::setMatrix(int index, const Matrix &m) {
+  if (index < 0 || index >= count) {
+    throw std::out_of_range("Batch index out of range");
+  }
+  if (m.getRows() != rows || m.getCols() != cols) {
+    throw std::invalid_argument("Matrix dimensions must match the batch");
+  }
+  for (int i = 0; i < rows; i++)
+    for (int j = 0; j < cols; j++)
+      data[offset(index, i, j)] = m.rowPtr(i)[j];
+}
+
+MatrixBatch MatrixBatch::operator*(const MatrixBatch &other) const {
+  if (count != other.count || cols != other.rows) {
+    throw std::invalid_argument("Invalid dimensions for batch multiplication");
+  }
+  MatrixBatch result(count, rows, other.cols);
+  const int n = other.cols;
+  const long long cost = 2LL * rows * cols * n * LANES;
+  parallelRange(blocks, cost, [&](int first, int last) {
+    for (int b = first; b < last; b++) {
+      const double *a = block(b);
+      const double *bm = other.block(b);
+      double *c = result.block(b);
+      for (int i = 0; i < rows; i++) {
+        for (int k = 0; k < cols; k++) {
+          const double *aik = a + (i * cols + k) * LANES;
+          for (int j = 0; j < n; j++) {
+            const double *bkj = bm + (k * n + j) * LANES;
+            double *cij = c + (i * n + j) * LANES;
+            for (int l = 0; l < LANES; l++)
+              cij[l] += aik[l] * bkj[l];
+          }
+        }
+      }
+    }
+  });
+  return result;
+}
+
+MatrixBatch MatrixBatch::transpose() const {
+  MatrixBatch result(count, cols, rows);
+  parallelRange(blocks, 1LL * rows * cols * LANES, [&](int first, int last) {
+    for (int b = first; b < last; b++) {
+      const double *src = block(b);
+      double *dst = result.block(b);
+      for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+          const double *from = src + (i * cols + j) * LANES;
+          std::copy(from, from + LANES, dst + (j * rows + i) * LANES);
+        }
+      }
+    }
+  });
+  return result;
+}
+
+// Lane-wise row kernels. A row segment holds `width` elements of LANES
+// values each. Rows passed together never overlap, and saying so with
+// __restrict lets the compiler vectorize across the lanes.
+
+// dst -= factor * src
+static BATCH_INLINE void rowUpdate(double *__restrict dst,
+                                   const double *__restrict src,
+                                   const double *__restrict factor,
+                                   int width) {
+  for (int j = 0; j < width; j++)
+    for (int l = 0; l < LANES; l++)
+      dst[j * LANES + l] -= factor[l] * src[j * LANES + l];
+}
+
+// row *= scale
+static BATCH_INLINE void rowScale(double *__restrict row,
+                                  const double *__restrict scale, int width) {
+  for (int j = 0; j < width; j++)
+    for (int l = 0; l < LANES; l++)
+      row[j * LANES + l] *= scale[l];
+}
+
+// Swap the lanes of rows a and b where mask is all ones (mask is either
+// all ones or all zeros). Done with bit operations so there is no branch.
+static BATCH_INLINE void rowSwapLanes(double *__restrict a,
+                                      double *__restrict b,
+                                      const std::uint64_t *__restrict mask,
+                                      int width) {
+  for (int j = 0; j < width; j++) {
+    for (int l = 0; l < LANES; l++) {
+      std::uint64_t x, y;
+      std::memcpy(&x, &a[j * LANES + l], sizeof x);
+      std::memcpy(&y, &b[j * LANES + l], sizeof y);
+      const std::uint64_t diff = (x ^ y) & mask[l];
+      x ^= diff;
+      y ^= diff;
+      std::memcpy(&a[j * LANES + l], &x, sizeof x);
+      std::memcpy(&b[j * LANES + l], &y, sizeof y);
+    }
+  }
+}
+
+// Partial pivoting without branches: row k is compare-swapped with every
+// row below it, lane by lane, so afterwards each lane holds its largest
+// pivot candidate in row k. Flips sign[l] for each swap in lane l.
+static BATCH_INLINE void pivotRows(double *a, int n, int width, int k,
+                                   double *sign) {
+  double *rowK = a + std::size_t(k) * width * LANES;
+  for (int r = k + 1; r < n; r++) {
+    double *rowR = a + std::size_t(r) * width * LANES;
+    std::uint64_t mask[LANES];
+    for (int l = 0; l < LANES; l++)
+      mask[l] = std::abs(rowR[k * LANES + l]) > std::abs(rowK[k * LANES + l])
+                    ? ~std::uint64_t(0)
+                    : 0;
+    rowSwapLanes(rowK, rowR, mask, width);
+    if (sign) {
+      for (int l = 0; l < LANES; l++)
+        sign[l] = mask[l] ? -sign[l] : sign[l];
+    }
+  }
+}
+
+// Determinants of the LANES matrices in one block; `a` is n*n*LANES scratch
+static BATCH_KERNEL void determinantBlock(const double *src, int n,
+                                          double *a, double *det) {
+  std::copy(src, src + std::size_t(n) * n * LANES, a);
+  for (int l = 0; l < LANES; l++)
+    det[l] = 1.0;
+  for (int k = 0; k < n; k++) {
+    pivotRows(a, n, n, k, det);
+    const double *rowK = a + std::size_t(k) * n * LANES;
+    double invPivot[LANES];
+    for (int l = 0; l < LANES; l++) {
+      const double pivot = rowK[k * LANES + l];
+      det[l] *= pivot;
+      invPivot[l] = pivot != 0.0 ? 1.0 / pivot : 0.0;
+    }
+    for (int i = k + 1; i < n; i++) {
+      double *rowI = a + std::size_t(i) * n * LANES;
+      double factor[LANES];
+      for (int l = 0; l < LANES; l++)
+        factor[l] = rowI[k * LANES + l] * invPivot[l];
+      rowUpdate(rowI + (k + 1) * LANES, rowK + (k + 1) * LANES, factor,
+                n - k - 1);
+    }
+  }
+}
+
+// Gauss-Jordan inverses of the LANES matrices in one block; `a` is
+// n*2n*LANES scratch for the augmented [A | I]
+static BATCH_KERNEL void inverseBlock(const double *src, int n, double *a,
+                                      double *dst) {
+  const int width = 2 * n;
+  std::fill(a, a + std::size_t(n) * width * LANES, 0.0);
+  for (int i = 0; i < n; i++) {
+    double *row = a + std::size_t(i) * width * LANES;
+    std::copy(src + i * n * LANES, src + (i + 1) * n * LANES, row);
+    for (int l = 0; l < LANES; l++)
+      row[(n + i) * LANES + l] = 1.0;
+  }
+  bool singular[LANES] = {};
+  for (int k = 0; k < n; k++) {
+    pivotRows(a, n, width, k, nullptr);
+    double *rowK = a + std::size_t(k) * width * LANES;
+    double invPivot[LANES];
+    for (int l = 0; l < LANES; l++) {
+      const double pivot = rowK[k * LANES + l];
+      const bool tiny = std::abs(pivot) < EPSILON;
+      singular[l] = singular[l] || tiny;
+      invPivot[l] = tiny ? 0.0 : 1.0 / pivot;
+    }
+    rowScale(rowK, invPivot, width);
+    for (int i = 0; i < n; i++) {
+      if (i == k)
+        continue;
+      double *rowI = a + std::size_t(i) * width * LANES;
+      double factor[LANES];
+      for (int l = 0; l < LANES; l++)
+        factor[l] = rowI[k * LANES + l];
+      rowUpdate(rowI, rowK, factor, width);
+    }
+  }
+  for (int i = 0; i < n; i++) {
+    const double *row = a + (std::size_t(i) * width + n) * LANES;
+    for (int j = 0; j < n; j++)
+      for (int l = 0; l < LANES; l++)
+        dst[(i * n + j) * LANES + l] =
+            singular[l] ? std::numeric_limits<double>::quiet_NaN()
+                        : row[j * LANES + l];
+  }
+}
+
+std::vector<double> MatrixBatch::determinant() const {
+  if (rows != cols) {
+    throw std::invalid_argument(
+        "Determinant is only defined for square matrices");
+  }
+  const int n = rows;
+  std::vector<double> result(std::size_t(blocks) * LANES);
+  parallelRange(blocks, 1LL * n * n * n * LANES, [&](int first, int last) {
+    std::vector<double> scratch(std::size_t(n) * n * LANES);
+    for (int b = first; b < last; b++) {
+      double *det = result.data() + std::size_t(b) * LANES;
+      determinantBlock(block(b), n, scratch.data(), det);
+      for (int l = 0; l < LANES; l++)
+        det[l] = det[l] == 0.0 ? 0.0 : det[l];
+    }
+  });
+  result.resize(count);
+  return result;
+}
+
+MatrixBatch MatrixBatch::inverse() const {
+  if (rows != cols) {
+    throw std::invalid_argument("Only square matrices can be inverted");
+  }
+  const int n = rows;
+  MatrixBatch result(count, n, n);
+  parallelRange(blocks, 2LL * n * n * n * LANES, [&](int first, int last) {
+    std::vector<double> scratch(std::size_t(n) * 2 * n * LANES);
+    for (int b = first; b < last; b++)
+      inverseBlock(block(b), n, scratch.data(), result.block(b));
+  });
+  return result;
+}
@@ -0,0 +1,57 @@
+#ifndef MATRIX_BATCH_H
+#define MATRIX_BATCH_H
+
+#include "Matrix.h"
+#include <cstddef>
+#include <vector>
+
+// A batch of `count` independent matrices of the same shape.
+//
+// Storage is structure-of-arrays in blocks of LANES matrices: element (i, j)
+// of the LANES matrices in a block is stored contiguously, so the innermost
+// loop of every operation runs across matrices and maps one SIMD lane to
+// one matrix. Blocks are independent and are spread over the thread pool.
+class MatrixBatch {
+public:
+  static const int LANES = 8;
+
+private:
+  int count;
+  int rows;
+  int cols;
+  int blocks;
+  std::vector<double> data;
+
+  std::size_t offset(int index, int i, int j) const {
+    return ((std::size_t(index / LANES) * rows + i) * cols + j) * LANES +
+           index % LANES;
+  }
+  double *block(int b) {
+    return data.data() + std::size_t(b) * rows * cols * LANES;
+  }
+  const double *block(int b) const {
+    return data.data() + std::size_t(b) * rows * cols * LANES;
+  }
+
+public:
+  MatrixBatch(int count, int rows, int cols);
+
+  // Getters
+  int getCount() const { return count; }
+  int getRows() const { return rows; }
+  int getCols() const { return cols; }
+  double get(int index, int i, int j) const;
+  void set(int index, int i, int j, double value);
+  Matrix getMatrix(int index) const;
+  void setMatrix(int index, const Matrix &m);
+
+  // Batched operations, applied to each matrix independently
+  MatrixBatch operator*(const MatrixBatch &other) const;
+  MatrixBatch transpose() const;
+  std::vector<double> determinant() const;
+  // Singular matrices come back filled with NaN instead of throwing, so one
+  // bad input does not abort the whole batch
+  MatrixBatch inverse() const;
+};
+
+#endif
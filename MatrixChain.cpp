@@ -0,0 +1,187 @@
+#include "MatrixChain.h"
+#include "Gemm.h"
+#include "MatrixArena.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <limits>
+#include <memory_resource>
+#include <stdexcept>
+
+MatrixChain::MatrixChain(std::initializer_list<MatrixView> matrices) {
+  for (const MatrixView &m : matrices)
+    append(m);
+}
+
+MatrixChain &MatrixChain::append(const MatrixView &m) {
+  if (!operands.empty() && operands.back().getCols() != m.getRows()) {
+    throw std::invalid_argument("Invalid dimensions for matrix multiplication");
+  }
+  operands.push_back(m);
+  return *this;
+}
+
+// cost[i][j] = min over s of cost[i][s] + cost[s+1][j] + d[i] d[s+1] d[j+1],
+// filled by increasing chain length
+double MatrixChain::plan(std::vector<int> &split) const {
+  const int k = size();
+  std::vector<double> dims(k + 1);
+  for (int i = 0; i < k; i++)
+    dims[i] = operands[i].getRows();
+  dims[k] = operands[k - 1].getCols();
+
+  std::vector<double> cost(static_cast<std::size_t>(k) * k, 0.0);
+  split.assign(static_cast<std::size_t>(k) * k, 0);
+  for (int length = 2; length <= k; length++) {
+    for (int i = 0; i + length <= k; i++) {
+      const int j = i + length - 1;
+      double best = std::numeric_limits<double>::infinity();
+      for (int s = i; s < j; s++) {
+        const double c = cost[i * k + s] + cost[(s + 1) * k + j] +
+                         dims[i] * dims[s + 1] * dims[j + 1];
+        if (c < best) {
+          best = c;
+          split[i * k + j] = s;
+        }
+      }
+      cost[i * k + j] = best;
+    }
+  }
+  return cost[k - 1];
+}
+
+double MatrixChain::cost() const {
+  if (operands.empty())
+    return 0.0;
+  std::vector<int> split;
+  return plan(split);
+}
+
+double MatrixChain::naiveCost() const {
+  double total = 0.0;
+  for (int i = 1; i < size(); i++) {
+    total += static_cast<double>(operands[0].getRows()) *
+             operands[i].getRows() * operands[i].getCols();
+  }
+  return total;
+}
+
+static std::string describe(const std::vector<int> &split, int k, int i,
+                            int j) {
+  if (i == j)
+    return std::to_string(i);
+  const int s = split[i * k + j];
+  return "(" + describe(split, k, i, s) + " " + describe(split, k, s + 1, j) +
+         ")";
+}
+
+std::string MatrixChain::order() const {
+  if (operands.empty())
+    return "";
+  std::vector<int> split;
+  plan(split);
+  return describe(split, size(), 0, size() - 1);
+}
+
+// Scratch buffers for the intermediate products. A finished product's
+// buffer goes back to the free list as soon as its parent has consumed it,
+// and a new product takes the smallest free buffer that fits (growing the
+// largest one if none does), so a chain allocates about as many buffers
+// as the evaluation tree is deep.
+struct ChainScratch {
+  std::vector<std::pmr::vector<double>> buffers;
+  std::vector<int> freeList;
+
+  int acquire(std::size_t elements) {
+    int best = -1; // index into freeList
+    for (std::size_t f = 0; f < freeList.size(); f++) {
+      const std::size_t have = buffers[freeList[f]].size();
+      if (best < 0) {
+        best = static_cast<int>(f);
+        continue;
+      }
+      const std::size_t current = buffers[freeList[best]].size();
+      if (current >= elements ? (have >= elements && have < current)
+                              : have > current)
+        best = static_cast<int>(f);
+    }
+    int id;
+    if (best >= 0) {
+      id = freeList[best];
+      freeList.erase(freeList.begin() + best);
+    } else {
+      id = static_cast<int>(buffers.size());
+      buffers.emplace_back(MatrixResourceScope::current());
+    }
+    std::pmr::vector<double> &buffer = buffers[id];
+    if (buffer.size() < elements)
+      buffer.resize(elements);
+    std::fill(buffer.begin(), buffer.begin() + elements, 0.0);
+    return id;
+  }
+
+  void release(int id) {
+    if (id >= 0)
+      freeList.push_back(id);
+  }
+};
+
+// A step's result: an operand of the chain (buffer -1) or a product held
+// in a scratch buffer
+struct ChainValue {
+  MatrixView view;
+  int buffer;
+};
+
+// Multiplies operands i..j. The outermost product goes to `out` (a
+// zeroed rows x cols block with leading dimension ldOut) when given.
+static ChainValue multiplyRange(const std::vector<MatrixView> &operands,
+                                const std::vector<int> &split, int i, int j,
+                                ChainScratch &scratch, double *out,
+                                int ldOut) {
+  const int k = static_cast<int>(operands.size());
+  if (i == j)
+    return {operands[i], -1};
+  const int s = split[i * k + j];
+  const ChainValue left =
+      multiplyRange(operands, split, i, s, scratch, nullptr, 0);
+  const ChainValue right =
+      multiplyRange(operands, split, s + 1, j, scratch, nullptr, 0);
+  const int rows = left.view.getRows();
+  const int cols = right.view.getCols();
+  int buffer = -1;
+  if (out == nullptr) {
+    buffer = scratch.acquire(static_cast<std::size_t>(rows) * cols);
+    out = scratch.buffers[buffer].data();
+    ldOut = cols;
+  }
+  gemm(rows, cols, left.view.getCols(), left.view.data(),
+       left.view.getStride(), right.view.data(), right.view.getStride(), out,
+       ldOut);
+  scratch.release(left.buffer);
+  scratch.release(right.buffer);
+  return {MatrixView(out, rows, cols, ldOut), buffer};
+}
+
+Matrix MatrixChain::evaluate() const {
+  if (operands.empty()) {
+    throw std::invalid_argument("Cannot evaluate an empty matrix chain");
+  }
+  const int k = size();
+  const int rows = operands.front().getRows();
+  const int cols = operands.back().getCols();
+  if (k == 1)
+    return Matrix(operands.front());
+
+  std::vector<int> split;
+  const double multiplyAdds = plan(split);
+  int largest = 0;
+  for (const MatrixView &m : operands)
+    largest = std::max({largest, m.getRows(), m.getCols()});
+  ProfileScope profile(ProfileOp::Multiply, largest, 2.0 * multiplyAdds);
+
+  Matrix result(rows, cols);
+  ChainScratch scratch;
+  multiplyRange(operands, split, 0, k - 1, scratch, result.rowPtr(0),
+                result.getStride());
+  return result;
+}
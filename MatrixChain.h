@@ -0,0 +1,51 @@
+#ifndef MATRIX_CHAIN_H
+#define MATRIX_CHAIN_H
+
+#include "Matrix.h"
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+// Product of a chain of matrices A0 * A1 * ... * Ak-1, multiplied in the
+// order that needs the fewest scalar operations:
+//
+//   Matrix P = MatrixChain{A, B, C, D}.evaluate();
+//
+// Matrix::operator* always groups from the left. With tall or skinny
+// operands that can cost orders of magnitude more: for A (n x 1),
+// B (1 x n) and C (n x 1), (A * B) * C takes n^2 multiply-adds and an
+// n x n temporary, while A * (B * C) takes 2n and a 1 x 1 one. The order
+// is chosen by the classic O(k^3) dynamic program over the dimensions.
+//
+// The chain holds views, so the operands must outlive it. Intermediate
+// products are written into a few scratch buffers that are recycled
+// between steps, and the final step writes straight into the result.
+class MatrixChain {
+private:
+  std::vector<MatrixView> operands;
+
+  // split[i * k + j] = s means operands i..j are best multiplied as
+  // (i..s) * (s+1..j); returns the cost of the whole chain
+  double plan(std::vector<int> &split) const;
+
+public:
+  MatrixChain() = default;
+  // Throws std::invalid_argument if adjacent dimensions do not match
+  MatrixChain(std::initializer_list<MatrixView> matrices);
+
+  // Appends a factor on the right
+  MatrixChain &append(const MatrixView &m);
+
+  int size() const { return static_cast<int>(operands.size()); }
+
+  // Multiply-adds of the chosen order and of left-to-right evaluation
+  double cost() const;
+  double naiveCost() const;
+  // The chosen parenthesization by operand index, e.g. "(0 (1 2))"
+  std::string order() const;
+
+  // Throws std::invalid_argument for an empty chain
+  Matrix evaluate() const;
+};
+
+#endif
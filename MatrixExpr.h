@@ -0,0 +1,186 @@
+#ifndef MATRIX_EXPR_H
+#define MATRIX_EXPR_H
+
+// Expression templates for element-wise Matrix arithmetic.
+//
+// operator+, operator- and scalar operator* do not compute anything: they
+// return small expression objects that record the operands. The work is
+// done when the expression is assigned to a Matrix, in one fused loop and
+// without intermediate matrices. Operands are held by reference, so an
+// expression must not outlive the matrices it was built from.
+
+#include "Matrix.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+
+template <typename E> class MatrixExpr {
+public:
+  const E &self() const { return static_cast<const E &>(*this); }
+  int getRows() const { return self().getRows(); }
+  int getCols() const { return self().getCols(); }
+
+  // Value at linear (row-major) index k
+  double at(std::size_t k) const { return self().at(k); }
+
+  Matrix eval() const { return Matrix(*this); }
+};
+
+// Leaf node referring to the storage of an existing Matrix
+class MatrixLeaf : public MatrixExpr<MatrixLeaf> {
+private:
+  const double *values;
+  int rows;
+  int cols;
+
+public:
+  explicit MatrixLeaf(const Matrix &m)
+      : values(m.rowPtr(0)), rows(m.getRows()), cols(m.getCols()) {}
+
+  int getRows() const { return rows; }
+  int getCols() const { return cols; }
+  double at(std::size_t k) const { return values[k]; }
+};
+
+struct AddOp {
+  static const char *name() { return "addition"; }
+  static double apply(double a, double b) { return a + b; }
+};
+
+struct SubtractOp {
+  static const char *name() { return "subtraction"; }
+  static double apply(double a, double b) { return a - b; }
+};
+
+template <typename L, typename R, typename Op>
+class MatrixBinaryExpr : public MatrixExpr<MatrixBinaryExpr<L, R, Op>> {
+private:
+  L lhs;
+  R rhs;
+
+public:
+  MatrixBinaryExpr(const L &l, const R &r) : lhs(l), rhs(r) {
+    if (l.getRows() != r.getRows() || l.getCols() != r.getCols()) {
+      throw std::invalid_argument(
+          std::string("Matrix dimensions must match for ") + Op::name());
+    }
+  }
+
+  int getRows() const { return lhs.getRows(); }
+  int getCols() const { return lhs.getCols(); }
+  double at(std::size_t k) const { return Op::apply(lhs.at(k), rhs.at(k)); }
+};
+
+template <typename E>
+class MatrixScaledExpr : public MatrixExpr<MatrixScaledExpr<E>> {
+private:
+  E expr;
+  double scalar;
+
+public:
+  MatrixScaledExpr(const E &e, double s) : expr(e), scalar(s) {}
+
+  int getRows() const { return expr.getRows(); }
+  int getCols() const { return expr.getCols(); }
+  double at(std::size_t k) const { return expr.at(k) * scalar; }
+};
+
+// Maps an operand type (Matrix or expression) to the node stored in a
+// parent expression. Other types have no `type` member, which removes the
+// operators below from overload resolution.
+template <typename T, typename = void> struct ExprOperand {};
+
+template <> struct ExprOperand<Matrix> {
+  typedef MatrixLeaf type;
+  static type wrap(const Matrix &m) { return MatrixLeaf(m); }
+};
+
+template <typename T>
+struct ExprOperand<T, typename std::enable_if<
+                          std::is_base_of<MatrixExpr<T>, T>::value>::type> {
+  typedef T type;
+  static const T &wrap(const T &e) { return e; }
+};
+
+template <typename L, typename R>
+MatrixBinaryExpr<typename ExprOperand<L>::type, typename ExprOperand<R>::type,
+                 AddOp>
+operator+(const L &lhs, const R &rhs) {
+  return {ExprOperand<L>::wrap(lhs), ExprOperand<R>::wrap(rhs)};
+}
+
+template <typename L, typename R>
+MatrixBinaryExpr<typename ExprOperand<L>::type, typename ExprOperand<R>::type,
+                 SubtractOp>
+operator-(const L &lhs, const R &rhs) {
+  return {ExprOperand<L>::wrap(lhs), ExprOperand<R>::wrap(rhs)};
+}
+
+template <typename T>
+MatrixScaledExpr<typename ExprOperand<T>::type> operator*(const T &operand,
+                                                          double scalar) {
+  return {ExprOperand<T>::wrap(operand), scalar};
+}
+
+template <typename T>
+MatrixScaledExpr<typename ExprOperand<T>::type> operator*(double scalar,
+                                                          const T &operand) {
+  return {ExprOperand<T>::wrap(operand), scalar};
+}
+
+// Matrix products are not element-wise: evaluate the expression first
+template <typename E>
+Matrix operator*(const MatrixExpr<E> &lhs, const Matrix &rhs) {
+  return Matrix(lhs) * rhs;
+}
+
+template <typename E1, typename E2>
+Matrix operator*(const MatrixExpr<E1> &lhs, const MatrixExpr<E2> &rhs) {
+  return Matrix(lhs) * Matrix(rhs);
+}
+
+// Evaluation. Every leaf of an element-wise expression has the shape of the
+// result, and element k only reads element k of each leaf, so assigning an
+// expression to one of its own operands (A = A + B) is safe.
+template <typename E> void Matrix::evaluate(const MatrixExpr<E> &expr) {
+  ProfileScope profile(ProfileOp::Elementwise, std::max(rows, cols),
+                       double(rows) * cols);
+  invalidate();
+  const E &e = expr.self();
+  parallelRange(rows, cols, [&](int first, int last) {
+    double *out = data.data();
+    const std::size_t end = std::size_t(last) * cols;
+    for (std::size_t k = std::size_t(first) * cols; k < end; k++)
+      out[k] = e.at(k);
+  });
+}
+
+template <typename E>
+Matrix::Matrix(const MatrixExpr<E> &expr)
+    : Matrix(expr.getRows(), expr.getCols()) {
+  evaluate(expr);
+}
+
+template <typename E> Matrix &Matrix::operator+=(const MatrixExpr<E> &expr) {
+  return *this = *this + expr.self();
+}
+
+template <typename E> Matrix &Matrix::operator-=(const MatrixExpr<E> &expr) {
+  return *this = *this - expr.self();
+}
+
+template <typename E> Matrix &Matrix::operator=(const MatrixExpr<E> &expr) {
+  if (rows != expr.getRows() || cols != expr.getCols()) {
+    // A differently shaped matrix cannot be an operand, so reshape first
+    rows = expr.getRows();
+    cols = expr.getCols();
+    stride = cols;
+    data.assign(std::size_t(rows) * stride, 0.0);
+  }
+  evaluate(expr);
+  return *this;
+}
+
+#endif
@@ -0,0 +1,233 @@
+#include "MatrixFile.h"
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char MATRIX_MAGIC[8] = {'L', 'A', 'M', 'A', 'T', 'R', 'I', 'X'};
+
+static_assert(sizeof(MatrixFileHeader) == 64, "header must be 64 bytes");
+
+// The payload is stored little-endian and used in place
+static bool hostIsLittleEndian() {
+  const std::uint16_t probe = 1;
+  unsigned char first;
+  std::memcpy(&first, &probe, 1);
+  return first == 1;
+}
+
+// Checks the header against the file size and returns a view of the payload
+static MatrixView validate(const std::string &path, const void *base,
+                           std::size_t length) {
+  if (length < sizeof(MatrixFileHeader))
+    throw std::runtime_error("Not a matrix file: " + path);
+  MatrixFileHeader h;
+  std::memcpy(&h, base, sizeof(h));
+  if (std::memcmp(h.magic, MATRIX_MAGIC, sizeof(MATRIX_MAGIC)) != 0)
+    throw std::runtime_error("Not a matrix file: " + path);
+  if (h.version != MATRIX_FILE_VERSION)
+    throw std::runtime_error("Unsupported matrix file version: " + path);
+  if (h.dtype != MATRIX_DTYPE_FLOAT64 || !hostIsLittleEndian())
+    throw std::runtime_error("Unsupported matrix element type: " + path);
+  if (h.rows == 0 || h.cols == 0 || h.rows > INT_MAX || h.cols > INT_MAX ||
+      h.stride < h.cols || h.stride > INT_MAX)
+    throw std::runtime_error("Invalid matrix dimensions in " + path);
+  // The payload may not overlap the header
+  if (h.dataOffset < sizeof(MatrixFileHeader) ||
+      h.dataOffset % MATRIX_FILE_ALIGNMENT != 0 || h.dataOffset > length)
+    throw std::runtime_error("Invalid data offset in " + path);
+  // Last row only needs cols elements
+  std::uint64_t available = (length - h.dataOffset) / sizeof(double);
+  if (available < h.cols || (h.rows - 1) > (available - h.cols) / h.stride)
+    throw std::runtime_error("Matrix file is truncated: " + path);
+
+  const double *payload = reinterpret_cast<const double *>(
+      static_cast<const char *>(base) + h.dataOffset);
+  return MatrixView(payload, static_cast<int>(h.rows),
+                    static_cast<int>(h.cols), static_cast<int>(h.stride));
+}
+
+// Mapping
+
+#ifdef _WIN32
+
+MappedMatrix::MappedMatrix(const std::string &path)
+    : base(nullptr), length(0), fileHandle(INVALID_HANDLE_VALUE),
+      mappingHandle(nullptr), data(nullptr, 0, 0, 0) {
+  fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                           nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                           nullptr);
+  if (fileHandle == INVALID_HANDLE_VALUE)
+    throw std::runtime_error("Cannot open matrix file: " + path);
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(fileHandle, &size)) {
+    unmap();
+    throw std::runtime_error("Cannot read matrix file: " + path);
+  }
+  length = static_cast<std::size_t>(size.QuadPart);
+  mappingHandle =
+      CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mappingHandle != nullptr)
+    base = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+  if (base == nullptr) {
+    unmap();
+    throw std::runtime_error("Cannot map matrix file: " + path);
+  }
+  try {
+    data = validate(path, base, length);
+  } catch (...) {
+    unmap();
+    throw;
+  }
+}
+
+void MappedMatrix::unmap() {
+  if (base != nullptr)
+    UnmapViewOfFile(base);
+  if (mappingHandle != nullptr)
+    CloseHandle(mappingHandle);
+  if (fileHandle != INVALID_HANDLE_VALUE)
+    CloseHandle(fileHandle);
+  base = nullptr;
+  mappingHandle = nullptr;
+  fileHandle = INVALID_HANDLE_VALUE;
+  length = 0;
+}
+
+MappedMatrix::MappedMatrix(MappedMatrix &&other) noexcept
+    : base(other.base), length(other.length), fileHandle(other.fileHandle),
+      mappingHandle(other.mappingHandle), data(other.data) {
+  other.base = nullptr;
+  other.mappingHandle = nullptr;
+  other.fileHandle = INVALID_HANDLE_VALUE;
+  other.length = 0;
+}
+
+MappedMatrix &MappedMatrix::operator=(MappedMatrix &&other) noexcept {
+  if (this != &other) {
+    unmap();
+    base = other.base;
+    length = other.length;
+    fileHandle = other.fileHandle;
+    mappingHandle = other.mappingHandle;
+    data = other.data;
+    other.base = nullptr;
+    other.mappingHandle = nullptr;
+    other.fileHandle = INVALID_HANDLE_VALUE;
+    other.length = 0;
+  }
+  return *this;
+}
+
+#else
+
+MappedMatrix::MappedMatrix(const std::string &path)
+    : base(nullptr), length(0), fd(-1), data(nullptr, 0, 0, 0) {
+  fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("Cannot open matrix file: " + path);
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    unmap();
+    throw std::runtime_error("Cannot read matrix file: " + path);
+  }
+  length = static_cast<std::size_t>(st.st_size);
+  if (length < sizeof(MatrixFileHeader)) {
+    unmap();
+    throw std::runtime_error("Not a matrix file: " + path);
+  }
+  void *p = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) {
+    unmap();
+    throw std::runtime_error("Cannot map matrix file: " + path);
+  }
+  base = p;
+  try {
+    data = validate(path, base, length);
+  } catch (...) {
+    unmap();
+    throw;
+  }
+}
+
+void MappedMatrix::unmap() {
+  if (base != nullptr)
+    ::munmap(base, length);
+  if (fd >= 0)
+    ::close(fd);
+  base = nullptr;
+  fd = -1;
+  length = 0;
+}
+
+MappedMatrix::MappedMatrix(MappedMatrix &&other) noexcept
+    : base(other.base), length(other.length), fd(other.fd),
+      data(other.data) {
+  other.base = nullptr;
+  other.fd = -1;
+  other.length = 0;
+}
+
+MappedMatrix &MappedMatrix::operator=(MappedMatrix &&other) noexcept {
+  if (this != &other) {
+    unmap();
+    base = other.base;
+    length = other.length;
+    fd = other.fd;
+    data = other.data;
+    other.base = nullptr;
+    other.fd = -1;
+    other.length = 0;
+  }
+  return *this;
+}
+
+#endif
+
+MappedMatrix::~MappedMatrix() { unmap(); }
+
+// Reading and writing
+
+void writeMatrixFile(const std::string &path, const MatrixView &m) {
+  if (!hostIsLittleEndian())
+    throw std::runtime_error("Matrix files require a little-endian host");
+  if (m.getRows() == 0 || m.getCols() == 0)
+    throw std::invalid_argument("Cannot write an empty matrix");
+  MatrixFileHeader h;
+  std::memset(&h, 0, sizeof(h));
+  std::memcpy(h.magic, MATRIX_MAGIC, sizeof(MATRIX_MAGIC));
+  h.version = MATRIX_FILE_VERSION;
+  h.dtype = MATRIX_DTYPE_FLOAT64;
+  h.rows = static_cast<std::uint64_t>(m.getRows());
+  h.cols = static_cast<std::uint64_t>(m.getCols());
+  h.stride = h.cols;
+  h.dataOffset = MATRIX_FILE_ALIGNMENT;
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out)
+    throw std::runtime_error("Cannot create matrix file: " + path);
+  char header[MATRIX_FILE_ALIGNMENT] = {};
+  std::memcpy(header, &h, sizeof(h));
+  out.write(header, sizeof(header));
+  const std::streamsize rowBytes =
+      static_cast<std::streamsize>(m.getCols() * sizeof(double));
+  for (int i = 0; i < m.getRows(); i++)
+    out.write(reinterpret_cast<const char *>(m.rowPtr(i)), rowBytes);
+  out.flush();
+  if (!out)
+    throw std::runtime_error("Failed to write matrix file: " + path);
+}
+
+Matrix readMatrixFile(const std::string &path) {
+  MappedMatrix mapped(path);
+  return Matrix(mapped.view());
+}
@@ -0,0 +1,76 @@
+#ifndef MATRIX_FILE_H
+#define MATRIX_FILE_H
+
+#include "Matrix.h"
+#include <cstdint>
+#include <string>
+
+// Binary matrix file (.mat):
+//
+//   offset  size  field
+//        0     8  magic "LAMATRIX"
+//        8     4  version (1)
+//       12     4  dtype (1 = float64, little-endian)
+//       16     8  rows
+//       24     8  cols
+//       32     8  stride, elements between consecutive rows (>= cols)
+//       40     8  dataOffset, start of the payload (multiple of 64,
+//                  past the header)
+//       48    16  reserved, zero
+//
+// The payload is the row-major elements. It starts on a 64-byte boundary
+// so a mapped file can be used in place by the SIMD kernels.
+struct MatrixFileHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t dtype;
+  std::uint64_t rows;
+  std::uint64_t cols;
+  std::uint64_t stride;
+  std::uint64_t dataOffset;
+  std::uint8_t reserved[16];
+};
+
+const std::uint32_t MATRIX_FILE_VERSION = 1;
+const std::uint32_t MATRIX_DTYPE_FLOAT64 = 1;
+const std::uint64_t MATRIX_FILE_ALIGNMENT = 64;
+
+// Read-only memory mapping of a matrix file. Elements are paged in by the
+// OS on first access, so opening a file costs no parsing or copying.
+// The view stays valid for the lifetime of the MappedMatrix.
+class MappedMatrix {
+private:
+  void *base;
+  std::size_t length;
+#ifdef _WIN32
+  void *fileHandle;
+  void *mappingHandle;
+#else
+  int fd;
+#endif
+  MatrixView data;
+
+  void unmap();
+
+public:
+  explicit MappedMatrix(const std::string &path);
+  ~MappedMatrix();
+
+  MappedMatrix(const MappedMatrix &) = delete;
+  MappedMatrix &operator=(const MappedMatrix &) = delete;
+  MappedMatrix(MappedMatrix &&other) noexcept;
+  MappedMatrix &operator=(MappedMatrix &&other) noexcept;
+
+  int getRows() const { return data.getRows(); }
+  int getCols() const { return data.getCols(); }
+  const MatrixView &view() const { return data; }
+  operator MatrixView() const { return data; }
+};
+
+// Writes m in the binary format; throws std::runtime_error on I/O failure
+void writeMatrixFile(const std::string &path, const MatrixView &m);
+
+// Maps the file and copies it into an owning Matrix
+Matrix readMatrixFile(const std::string &path);
+
+#endif
@@ -0,0 +1,568 @@
+#include "MatrixServer.h"
+#include "MatrixArena.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// Requests waiting for the dispatcher before readers block (backpressure)
+static const std::size_t MAX_QUEUED = 4 * MatrixServer::MAX_BATCH;
+
+// Unwritten response bytes of one connection before its reader stops
+// taking requests, so a client that does not read cannot grow them forever
+static const std::size_t MAX_OUTBOUND = 16u << 20;
+
+// Estimated element updates above which a request runs on its own, with
+// the whole pool available to it (about a 64 x 64 multiply)
+static const long long LARGE_REQUEST = 64 * 64 * 64;
+
+// How often the accept loop checks for stop()
+static const int POLL_INTERVAL_MS = 100;
+
+static const std::uint8_t KIND_SCALAR = 0;
+static const std::uint8_t KIND_MATRIX = 1;
+static const std::uint8_t KIND_ERROR = 2;
+
+// Frames are copied to and from host memory directly
+static bool hostIsLittleEndian() {
+  const std::uint16_t probe = 1;
+  unsigned char first;
+  std::memcpy(&first, &probe, 1);
+  return first == 1;
+}
+
+// Encoding
+
+template <typename T> static void put(std::string &out, T value) {
+  out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void putMatrix(std::string &out, const Matrix &m) {
+  put(out, static_cast<std::uint32_t>(m.getRows()));
+  put(out, static_cast<std::uint32_t>(m.getCols()));
+  const std::size_t rowBytes = m.getCols() * sizeof(double);
+  for (int i = 0; i < m.getRows(); i++)
+    out.append(reinterpret_cast<const char *>(m.rowPtr(i)), rowBytes);
+}
+
+// Writes the length field of a frame started at `start`
+static void finishFrame(std::string &out, std::size_t start) {
+  const std::uint32_t length =
+      static_cast<std::uint32_t>(out.size() - start - sizeof(std::uint32_t));
+  std::memcpy(&out[start], &length, sizeof(length));
+}
+
+static void appendResponse(std::string &out, std::uint32_t id,
+                           std::uint8_t kind) {
+  put(out, std::uint32_t(0));
+  put(out, id);
+  put(out, kind);
+  put(out, std::uint8_t(0));
+  put(out, std::uint16_t(0));
+}
+
+// Decoding
+
+// Bounds-checked cursor over a frame body
+class FrameReader {
+private:
+  const char *pos;
+  const char *end;
+
+public:
+  FrameReader(const std::string &body)
+      : pos(body.data()), end(body.data() + body.size()) {}
+
+  std::size_t remaining() const {
+    return static_cast<std::size_t>(end - pos);
+  }
+
+  void take(void *out, std::size_t bytes) {
+    if (bytes > remaining())
+      throw std::runtime_error("Malformed frame");
+    std::memcpy(out, pos, bytes);
+    pos += bytes;
+  }
+
+  template <typename T> T get() {
+    T value;
+    take(&value, sizeof(value));
+    return value;
+  }
+
+  Matrix matrix() {
+    const std::uint32_t rows = get<std::uint32_t>();
+    const std::uint32_t cols = get<std::uint32_t>();
+    if (rows == 0 || cols == 0 || rows > INT32_MAX || cols > INT32_MAX ||
+        static_cast<unsigned long long>(rows) * cols >
+            remaining() / sizeof(double))
+      throw std::runtime_error("Malformed frame");
+    Matrix m(static_cast<int>(rows), static_cast<int>(cols));
+    for (std::uint32_t i = 0; i < rows; i++)
+      take(m.rowPtr(i), cols * sizeof(double));
+    return m;
+  }
+};
+
+#ifndef _WIN32
+
+static bool readFully(int fd, void *buffer, std::size_t bytes) {
+  char *p = static_cast<char *>(buffer);
+  while (bytes > 0) {
+    const ssize_t n = ::read(fd, p, bytes);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    bytes -= static_cast<std::size_t>(n);
+  }
+  return true;
+}
+
+static bool writeFully(int fd, const char *data, std::size_t bytes) {
+  while (bytes > 0) {
+    const ssize_t n = ::send(fd, data, bytes, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data += n;
+    bytes -= static_cast<std::size_t>(n);
+  }
+  return true;
+}
+
+// Reads one frame into `body` (without its length field). Returns false
+// at end of stream; throws std::runtime_error for an oversized frame.
+static bool readFrame(int fd, std::string &body) {
+  std::uint32_t length;
+  if (!readFully(fd, &length, sizeof(length)))
+    return false;
+  if (length > MAX_FRAME_BYTES)
+    throw std::runtime_error("Frame too large");
+  body.resize(length);
+  return readFully(fd, &body[0], length);
+}
+
+static sockaddr_un socketAddress(const std::string &path) {
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(address.sun_path))
+    throw std::runtime_error("Invalid socket path: " + path);
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+  return address;
+}
+
+// Server
+
+// One client. Its reader thread decodes requests into the shared queue,
+// and its writer thread sends the responses the dispatcher hands back, so
+// a client that reads slowly only holds up its own responses.
+struct ServerConnection {
+  int fd;
+  std::atomic<int> threads; // reader and writer threads still running
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::string outbound; // responses not yet written
+  int unanswered;       // requests read but not yet answered
+  bool reading;         // the reader may still queue requests
+  bool broken;          // a write failed; further responses are dropped
+
+  explicit ServerConnection(int socket)
+      : fd(socket), threads(2), unanswered(0), reading(true), broken(false) {}
+  ~ServerConnection() { ::close(fd); }
+
+  // Called by the dispatcher with the responses to `count` requests
+  void deliver(const std::string &responses, int count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!broken)
+      outbound += responses;
+    unanswered -= count;
+    changed.notify_all();
+  }
+};
+
+struct ServerRequest {
+  std::shared_ptr<ServerConnection> connection;
+  std::uint32_t id;
+  BatchOp op;
+  double param;
+  std::vector<Matrix> args;
+  long long cost; // rough element updates, to keep large requests apart
+};
+
+class RequestQueue {
+private:
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::condition_variable space;
+  std::deque<ServerRequest> requests;
+  bool closed = false;
+
+public:
+  void push(ServerRequest request) {
+    std::unique_lock<std::mutex> lock(mutex);
+    space.wait(lock, [&] { return requests.size() < MAX_QUEUED; });
+    requests.push_back(std::move(request));
+    ready.notify_one();
+  }
+
+  // Waits for work, then takes up to `limit` requests. Returns false once
+  // the queue is closed and empty.
+  bool popBatch(std::vector<ServerRequest> &batch, std::size_t limit) {
+    std::unique_lock<std::mutex> lock(mutex);
+    ready.wait(lock, [&] { return closed || !requests.empty(); });
+    batch.clear();
+    while (!requests.empty() && batch.size() < limit) {
+      batch.push_back(std::move(requests.front()));
+      requests.pop_front();
+    }
+    space.notify_all();
+    return !batch.empty();
+  }
+
+  void close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+    ready.notify_all();
+  }
+};
+
+static ServerRequest decodeRequest(const std::string &body) {
+  FrameReader reader(body);
+  ServerRequest request;
+  request.id = reader.get<std::uint32_t>();
+  request.op = static_cast<BatchOp>(reader.get<std::uint16_t>());
+  const std::uint16_t count = reader.get<std::uint16_t>();
+  request.param = reader.get<double>();
+  request.cost = 0;
+  for (int i = 0; i < count; i++) {
+    request.args.push_back(reader.matrix());
+    const Matrix &m = request.args.back();
+    request.cost += static_cast<long long>(m.getRows()) * m.getCols() *
+                    std::min(m.getRows(), m.getCols());
+  }
+  if (reader.remaining() != 0)
+    throw std::runtime_error("Malformed frame");
+  return request;
+}
+
+static void readRequests(std::shared_ptr<ServerConnection> connection,
+                         RequestQueue &queue) {
+  std::string body;
+  try {
+    while (readFrame(connection->fd, body)) {
+      ServerRequest request = decodeRequest(body);
+      request.connection = connection;
+      {
+        std::unique_lock<std::mutex> lock(connection->mutex);
+        connection->changed.wait(lock, [&] {
+          return connection->broken ||
+                 connection->outbound.size() < MAX_OUTBOUND;
+        });
+        if (connection->broken)
+          break;
+        connection->unanswered++;
+      }
+      queue.push(std::move(request));
+    }
+  } catch (const std::exception &) {
+    // Framing is lost after a malformed frame: hang up
+    ::shutdown(connection->fd, SHUT_RDWR);
+  }
+  {
+    std::lock_guard<std::mutex> lock(connection->mutex);
+    connection->reading = false;
+    connection->changed.notify_all();
+  }
+  connection->threads--;
+}
+
+// Sends responses as the dispatcher delivers them, until the reader has
+// stopped and every request it queued has been answered, or a write fails
+static void writeResponses(std::shared_ptr<ServerConnection> connection) {
+  std::string pending;
+  std::unique_lock<std::mutex> lock(connection->mutex);
+  while (true) {
+    connection->changed.wait(lock, [&] {
+      return !connection->outbound.empty() || connection->broken ||
+             (!connection->reading && connection->unanswered == 0);
+    });
+    if (connection->outbound.empty() || connection->broken)
+      break;
+    pending.clear();
+    pending.swap(connection->outbound);
+    connection->changed.notify_all(); // room for the reader again
+    lock.unlock();
+    const bool written =
+        writeFully(connection->fd, pending.data(), pending.size());
+    lock.lock();
+    if (!written) {
+      connection->broken = true;
+      connection->outbound.clear();
+      connection->changed.notify_all();
+      // Stops the reader too
+      ::shutdown(connection->fd, SHUT_RDWR);
+    }
+  }
+  lock.unlock();
+  connection->threads--;
+}
+
+static void execute(const ServerRequest &request, std::string &out) {
+  out.clear();
+  try {
+    BatchResult result = runOperation(request.op, request.args, request.param);
+    if (result.isScalar) {
+      appendResponse(out, request.id, KIND_SCALAR);
+      put(out, result.scalar);
+    } else {
+      appendResponse(out, request.id, KIND_MATRIX);
+      putMatrix(out, result.matrix);
+    }
+  } catch (const std::exception &e) {
+    out.clear();
+    appendResponse(out, request.id, KIND_ERROR);
+    out += e.what();
+  }
+  finishFrame(out, 0);
+}
+
+// Runs batches until the queue is closed. The responses for one
+// connection are handed to its writer together, once per batch.
+static void dispatch(RequestQueue &queue) {
+  std::vector<ServerRequest> batch;
+  std::vector<std::string> responses;
+  std::vector<int> small;
+  std::vector<int> order;
+  std::string combined;
+  while (queue.popBatch(batch, MatrixServer::MAX_BATCH)) {
+    const int count = static_cast<int>(batch.size());
+    responses.resize(count);
+    small.clear();
+    long long smallCost = 0;
+    for (int i = 0; i < count; i++) {
+      if (batch[i].cost < LARGE_REQUEST) {
+        small.push_back(i);
+        smallCost += batch[i].cost;
+      }
+    }
+    if (!small.empty()) {
+      const int n = static_cast<int>(small.size());
+      parallelRange(n, smallCost / n, [&](int first, int last) {
+        MatrixArena arena;
+        for (int s = first; s < last; s++)
+          execute(batch[small[s]], responses[small[s]]);
+      });
+    }
+    for (int i = 0; i < count; i++) {
+      if (batch[i].cost >= LARGE_REQUEST)
+        execute(batch[i], responses[i]);
+    }
+
+    order.resize(count);
+    for (int i = 0; i < count; i++)
+      order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+      return batch[a].connection < batch[b].connection;
+    });
+    for (int first = 0; first < count;) {
+      ServerConnection &connection = *batch[order[first]].connection;
+      combined.clear();
+      int last = first;
+      while (last < count && batch[order[last]].connection.get() ==
+                                 &connection)
+        combined += responses[order[last++]];
+      connection.deliver(combined, last - first);
+      first = last;
+    }
+    batch.clear(); // drops the connection references of this batch
+  }
+}
+
+MatrixServer::MatrixServer(const std::string &socketPath)
+    : path(socketPath), listenFd(-1), stopping(false) {
+  if (!hostIsLittleEndian())
+    throw std::runtime_error("The matrix server requires a little-endian host");
+  const sockaddr_un address = socketAddress(path);
+  struct stat info;
+  if (::lstat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+    // Only a socket nobody listens on any more is replaced
+    const int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe < 0)
+      throw std::runtime_error("Cannot create socket");
+    const bool live =
+        ::connect(probe, reinterpret_cast<const sockaddr *>(&address),
+                  sizeof(address)) == 0;
+    const bool stale = !live && errno == ECONNREFUSED;
+    ::close(probe);
+    if (live)
+      throw std::runtime_error("A server is already listening on " + path);
+    if (stale)
+      ::unlink(path.c_str());
+  }
+  listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listenFd < 0)
+    throw std::runtime_error("Cannot create socket");
+  if (::bind(listenFd, reinterpret_cast<const sockaddr *>(&address),
+             sizeof(address)) != 0 ||
+      ::listen(listenFd, SOMAXCONN) != 0) {
+    ::close(listenFd);
+    throw std::runtime_error("Cannot listen on " + path);
+  }
+}
+
+MatrixServer::~MatrixServer() {
+  ::close(listenFd);
+  ::unlink(path.c_str());
+}
+
+void MatrixServer::run() {
+  struct Client {
+    std::shared_ptr<ServerConnection> connection;
+    std::thread reader;
+    std::thread writer;
+  };
+  RequestQueue queue;
+  std::thread dispatcher(dispatch, std::ref(queue));
+  std::vector<Client> clients;
+
+  while (!stopping.load()) {
+    // Join the threads of clients that hung up
+    for (std::size_t c = 0; c < clients.size();) {
+      if (clients[c].connection->threads.load() > 0) {
+        c++;
+        continue;
+      }
+      clients[c].reader.join();
+      clients[c].writer.join();
+      clients.erase(clients.begin() + c);
+    }
+
+    pollfd listening = {listenFd, POLLIN, 0};
+    if (::poll(&listening, 1, POLL_INTERVAL_MS) <= 0)
+      continue;
+    const int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0)
+      continue;
+    Client client;
+    client.connection = std::make_shared<ServerConnection>(fd);
+    client.reader = std::thread(readRequests, client.connection,
+                                std::ref(queue));
+    client.writer = std::thread(writeResponses, client.connection);
+    clients.push_back(std::move(client));
+  }
+
+  for (Client &client : clients)
+    ::shutdown(client.connection->fd, SHUT_RDWR);
+  for (Client &client : clients)
+    client.reader.join();
+  queue.close();
+  dispatcher.join();
+  for (Client &client : clients)
+    client.writer.join();
+}
+
+// Client
+
+MatrixClient::MatrixClient(const std::string &path) : fd(-1) {
+  const sockaddr_un address = socketAddress(path);
+  fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    throw std::runtime_error("Cannot create socket");
+  if (::connect(fd, reinterpret_cast<const sockaddr *>(&address),
+                sizeof(address)) != 0) {
+    ::close(fd);
+    throw std::runtime_error("Cannot connect to matrix server at " + path);
+  }
+}
+
+MatrixClient::~MatrixClient() { ::close(fd); }
+
+void MatrixClient::send(std::uint32_t id, BatchOp op,
+                        const std::vector<Matrix> &args, double param) {
+  frame.clear();
+  put(frame, std::uint32_t(0));
+  put(frame, id);
+  put(frame, static_cast<std::uint16_t>(op));
+  put(frame, static_cast<std::uint16_t>(args.size()));
+  put(frame, param);
+  for (const Matrix &m : args)
+    putMatrix(frame, m);
+  if (frame.size() - sizeof(std::uint32_t) > MAX_FRAME_BYTES)
+    throw std::invalid_argument("Request too large");
+  finishFrame(frame, 0);
+  if (!writeFully(fd, frame.data(), frame.size()))
+    throw std::runtime_error("Connection to matrix server lost");
+}
+
+MatrixResponse MatrixClient::receive() {
+  if (!readFrame(fd, frame))
+    throw std::runtime_error("Connection to matrix server lost");
+  FrameReader reader(frame);
+  MatrixResponse response;
+  response.id = reader.get<std::uint32_t>();
+  const std::uint8_t kind = reader.get<std::uint8_t>();
+  reader.get<std::uint8_t>();
+  reader.get<std::uint16_t>();
+  response.ok = kind != KIND_ERROR;
+  if (kind == KIND_SCALAR) {
+    response.result.scalar = reader.get<double>();
+  } else if (kind == KIND_MATRIX) {
+    response.result.isScalar = false;
+    response.result.matrix = reader.matrix();
+  } else {
+    response.error.assign(frame.end() - reader.remaining(), frame.end());
+  }
+  return response;
+}
+
+#else
+
+MatrixServer::MatrixServer(const std::string &socketPath)
+    : path(socketPath), listenFd(-1), stopping(false) {
+  throw std::runtime_error("The matrix server requires Unix domain sockets");
+}
+
+MatrixServer::~MatrixServer() {}
+
+void MatrixServer::run() {}
+
+MatrixClient::MatrixClient(const std::string &) : fd(-1) {
+  throw std::runtime_error("The matrix server requires Unix domain sockets");
+}
+
+MatrixClient::~MatrixClient() {}
+
+void MatrixClient::send(std::uint32_t, BatchOp, const std::vector<Matrix> &,
+                        double) {}
+
+MatrixResponse MatrixClient::receive() { return MatrixResponse(); }
+
+#endif
+
+BatchResult MatrixClient::call(BatchOp op, const std::vector<Matrix> &args,
+                               double param) {
+  send(0, op, args, param);
+  MatrixResponse response = receive();
+  if (!response.ok)
+    throw std::runtime_error(response.error);
+  return std::move(response.result);
+}
@@ -0,0 +1,102 @@
+#ifndef MATRIX_SERVER_H
+#define MATRIX_SERVER_H
+
+#include "BatchMode.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Long-running compute server on a Unix domain socket (main --serve).
+//
+// A client connects and writes request frames; the server answers each
+// with one response frame carrying the request's id. Requests can be
+// pipelined, and responses may come back in a different order than the
+// requests were sent, so clients match them by id. Integers are
+// little-endian and numbers are IEEE float64:
+//
+//   request                          response
+//     u32  length of the rest          u32  length of the rest
+//     u32  id                          u32  id
+//     u16  op (BatchOp value)          u8   kind: 0 scalar, 1 matrix,
+//     u16  operand count                         2 error
+//     f64  param (quantile)            u8   reserved
+//     operands, each:                  u16  reserved
+//       u32 rows, u32 cols,            payload: f64 | u32 rows, u32 cols,
+//       rows * cols f64 row-major        rows * cols f64 | message bytes
+//
+// Operations run through runOperation(), like --batch, so statistics
+// operations use every element of their operand. A malformed frame (bad
+// length or dimensions) closes the connection; a failing operation only
+// produces an error response.
+const std::uint32_t MAX_FRAME_BYTES = 1u << 28;
+const char *const DEFAULT_SERVER_SOCKET = "/tmp/matrix-server.sock";
+
+// Requests decoded from the socket that the dispatcher has not run yet
+// are executed together: small ones are spread over the thread pool in
+// one parallel loop, each chunk recycling its temporaries through a
+// MatrixArena, and large ones run one at a time so their own operations
+// can use the whole pool. Every connection has its own reader and writer
+// thread, so a client that is slow to read its responses delays only
+// itself; once it has 16 MB of responses waiting, its reader stops taking
+// new requests.
+class MatrixServer {
+private:
+  std::string path;
+  int listenFd;
+  std::atomic<bool> stopping;
+
+public:
+  // Most requests executed as one batch
+  static const int MAX_BATCH = 256;
+
+  // Binds and listens on `path`, replacing a stale socket file. Throws
+  // std::runtime_error if the socket cannot be created, or if another
+  // server is still accepting connections on `path`.
+  explicit MatrixServer(const std::string &path);
+  ~MatrixServer();
+  MatrixServer(const MatrixServer &) = delete;
+  MatrixServer &operator=(const MatrixServer &) = delete;
+
+  // Serves clients until stop() is called; returns after every connection
+  // has been closed
+  void run();
+  // Safe to call from another thread or a signal handler
+  void stop() { stopping.store(true); }
+};
+
+// Response to one request
+struct MatrixResponse {
+  std::uint32_t id;
+  bool ok;
+  BatchResult result;
+  std::string error;
+};
+
+// Blocking client for the protocol above. Not thread-safe; use one client
+// per thread.
+class MatrixClient {
+private:
+  int fd;
+  std::string frame; // reused encoding buffer
+
+public:
+  // Throws std::runtime_error if the server is not reachable
+  explicit MatrixClient(const std::string &path);
+  ~MatrixClient();
+  MatrixClient(const MatrixClient &) = delete;
+  MatrixClient &operator=(const MatrixClient &) = delete;
+
+  // Writes one request without waiting for its response
+  void send(std::uint32_t id, BatchOp op, const std::vector<Matrix> &args,
+            double param = 0.0);
+  // Reads the next response. Throws std::runtime_error if the connection
+  // is closed.
+  MatrixResponse receive();
+
+  // send() then receive(); throws std::runtime_error for an error response
+  BatchResult call(BatchOp op, const std::vector<Matrix> &args,
+                   double param = 0.0);
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef MATRIX_VIEW_H
+#define MATRIX_VIEW_H
+
+// Non-owning, read-only views over row-major matrix storage. A view is a
+// pointer plus shape/stride, so rows, columns and sub-blocks of a Matrix
+// can be handed to Statistics or Matrix routines without copying.
+// A view must not outlive the storage it points into.
+
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+// Strided 1-D view: element i is at data()[i * getStride()]
+class VectorView {
+private:
+  const double *ptr;
+  int length;
+  int step;
+
+public:
+  VectorView() : ptr(nullptr), length(0), step(1) {}
+  VectorView(const double *values, int n, int stride = 1)
+      : ptr(values), length(n), step(stride) {}
+  VectorView(const std::vector<double> &values)
+      : ptr(values.data()), length(static_cast<int>(values.size())),
+        step(1) {}
+
+  int size() const { return length; }
+  bool empty() const { return length == 0; }
+  int getStride() const { return step; }
+  bool isContiguous() const { return step == 1; }
+  const double *data() const { return ptr; }
+  double operator[](int i) const { return ptr[std::ptrdiff_t(i) * step]; }
+
+  std::vector<double> toVector() const {
+    std::vector<double> out(length);
+    for (int i = 0; i < length; i++)
+      out[i] = (*this)[i];
+    return out;
+  }
+};
+
+// 2-D view with a leading dimension: element (i, j) is at
+// rowPtr(i)[j] = data()[i * getStride() + j]
+class MatrixView {
+private:
+  const double *ptr;
+  int rows;
+  int cols;
+  int stride;
+
+public:
+  MatrixView(const double *values, int r, int c, int ld)
+      : ptr(values), rows(r), cols(c), stride(ld) {}
+
+  int getRows() const { return rows; }
+  int getCols() const { return cols; }
+  int getStride() const { return stride; }
+  const double *data() const { return ptr; }
+  const double *rowPtr(int i) const {
+    return ptr + std::ptrdiff_t(i) * stride;
+  }
+  double operator()(int i, int j) const { return rowPtr(i)[j]; }
+
+  VectorView row(int i) const {
+    if (i < 0 || i >= rows)
+      throw std::out_of_range("Row index error");
+    return VectorView(rowPtr(i), cols, 1);
+  }
+
+  VectorView col(int j) const {
+    if (j < 0 || j >= cols)
+      throw std::out_of_range("Col index error");
+    return VectorView(ptr + j, rows, stride);
+  }
+
+  MatrixView block(int row0, int col0, int nRows, int nCols) const {
+    if (row0 < 0 || col0 < 0 || nRows < 1 || nCols < 1 ||
+        row0 + nRows > rows || col0 + nCols > cols) {
+      throw std::out_of_range("Block out of range");
+    }
+    return MatrixView(rowPtr(row0) + col0, nRows, nCols, stride);
+  }
+};
+
+#endif
@@ -0,0 +1,244 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+static const char *const OP_NAMES[] = {
+    "multiply",     "elementwise",     "transpose", "submatrix",
+    "lu",           "determinant",     "inverse",   "solve",
+    "rref",         "gram_schmidt",    "rank_one_update",
+    "mean",         "variance",        "quantile",  "column_statistics"};
+
+static_assert(sizeof(OP_NAMES) / sizeof(OP_NAMES[0]) ==
+                  static_cast<std::size_t>(ProfileOp::Count),
+              "one name per ProfileOp");
+
+// Each counter has a single writer (its thread), so updates are a plain
+// load and store; the atomics only make concurrent reports well defined
+struct ProfileCounter {
+  std::atomic<long long> calls;
+  std::atomic<long long> nanos;
+  std::atomic<long long> bytes;
+  std::atomic<double> flops;
+};
+
+struct ThreadCounters {
+  ProfileCounter counters[static_cast<int>(ProfileOp::Count)]
+                         [Profiler::SIZE_BUCKETS];
+  std::atomic<long long> allocated;
+};
+
+template <typename T> static void bump(std::atomic<T> &counter, T amount) {
+  counter.store(counter.load(std::memory_order_relaxed) + amount,
+                std::memory_order_relaxed);
+}
+
+// Counters of the running threads, plus the totals of the threads that
+// have exited. Never destroyed, so threads and the exit report can use it
+// at shutdown.
+struct ProfileRegistry {
+  std::mutex mutex;
+  std::vector<ThreadCounters *> threads;
+  ThreadCounters retired;
+};
+
+static ProfileRegistry &registry() {
+  static ProfileRegistry *instance = new ProfileRegistry();
+  return *instance;
+}
+
+// Adds every counter of `from` to `to`; the caller holds the registry lock
+static void fold(ThreadCounters &to, const ThreadCounters &from) {
+  for (int op = 0; op < static_cast<int>(ProfileOp::Count); op++) {
+    for (int b = 0; b < Profiler::SIZE_BUCKETS; b++) {
+      ProfileCounter &t = to.counters[op][b];
+      const ProfileCounter &f = from.counters[op][b];
+      bump(t.calls, f.calls.load(std::memory_order_relaxed));
+      bump(t.nanos, f.nanos.load(std::memory_order_relaxed));
+      bump(t.bytes, f.bytes.load(std::memory_order_relaxed));
+      bump(t.flops, f.flops.load(std::memory_order_relaxed));
+    }
+  }
+  bump(to.allocated, from.allocated.load(std::memory_order_relaxed));
+}
+
+// Set once the calling thread's counters have been retired; anything the
+// thread records after that goes straight to the retired totals
+static thread_local bool threadRetired = false;
+
+// Owns the calling thread's counters and retires them when it exits
+struct LocalCounters {
+  ThreadCounters *mine = nullptr;
+
+  ~LocalCounters() {
+    threadRetired = true;
+    if (mine == nullptr)
+      return;
+    ProfileRegistry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    fold(r.retired, *mine);
+    r.threads.erase(std::find(r.threads.begin(), r.threads.end(), mine));
+    delete mine;
+  }
+};
+
+// The calling thread's counters, or nullptr once they have been retired
+static ThreadCounters *localCounters() {
+  static thread_local LocalCounters local;
+  if (threadRetired)
+    return nullptr;
+  if (local.mine == nullptr) {
+    local.mine = new ThreadCounters(); // value-initialized: all zero
+    ProfileRegistry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.threads.push_back(local.mine);
+  }
+  return local.mine;
+}
+
+static int sizeBucket(std::size_t size) {
+  int bucket = 0;
+  while (size > 1 && bucket < Profiler::SIZE_BUCKETS - 1) {
+    size >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+static void reportAtExit() { Profiler::report(std::cerr); }
+
+static bool enabledByEnvironment() {
+  const char *env = std::getenv("MATRIX_PROFILE");
+  if (env == nullptr || *env == '\0' || std::strcmp(env, "0") == 0)
+    return false;
+  registry(); // constructed before the handler below can run
+  std::atexit(reportAtExit);
+  return true;
+}
+
+std::atomic<bool> Profiler::active(enabledByEnvironment());
+
+void Profiler::setEnabled(bool on) {
+  active.store(on, std::memory_order_relaxed);
+}
+
+void Profiler::record(ProfileOp op, std::size_t size, long long nanos,
+                      double flops, long long bytes) {
+  auto add = [&](ThreadCounters &t) {
+    ProfileCounter &c = t.counters[static_cast<int>(op)][sizeBucket(size)];
+    bump(c.calls, 1LL);
+    bump(c.nanos, nanos);
+    bump(c.bytes, bytes);
+    bump(c.flops, flops);
+  };
+  if (ThreadCounters *mine = localCounters()) {
+    add(*mine);
+    return;
+  }
+  ProfileRegistry &r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  add(r.retired);
+}
+
+void Profiler::addAllocation(std::size_t bytes) {
+  if (ThreadCounters *mine = localCounters()) {
+    bump(mine->allocated, static_cast<long long>(bytes));
+    return;
+  }
+  ProfileRegistry &r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  bump(r.retired.allocated, static_cast<long long>(bytes));
+}
+
+long long Profiler::allocatedBytes() {
+  ThreadCounters *mine = localCounters();
+  return mine == nullptr ? 0 : mine->allocated.load(std::memory_order_relaxed);
+}
+
+const char *Profiler::name(ProfileOp op) {
+  return OP_NAMES[static_cast<int>(op)];
+}
+
+void Profiler::reset() {
+  ProfileRegistry &r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  std::vector<ThreadCounters *> all = r.threads;
+  all.push_back(&r.retired);
+  for (ThreadCounters *t : all) {
+    for (auto &row : t->counters) {
+      for (ProfileCounter &c : row) {
+        c.calls.store(0, std::memory_order_relaxed);
+        c.nanos.store(0, std::memory_order_relaxed);
+        c.bytes.store(0, std::memory_order_relaxed);
+        c.flops.store(0.0, std::memory_order_relaxed);
+      }
+    }
+  }
+}
+
+// Rows (operation, size bucket) summed over threads, by total time
+void Profiler::report(std::ostream &out) {
+  struct Row {
+    int op;
+    int bucket;
+    long long calls;
+    long long nanos;
+    long long bytes;
+    double flops;
+  };
+  std::vector<Row> rows;
+  {
+    ProfileRegistry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::vector<const ThreadCounters *> all(r.threads.begin(),
+                                            r.threads.end());
+    all.push_back(&r.retired);
+    for (int op = 0; op < static_cast<int>(ProfileOp::Count); op++) {
+      for (int b = 0; b < SIZE_BUCKETS; b++) {
+        Row row = {op, b, 0, 0, 0, 0.0};
+        for (const ThreadCounters *t : all) {
+          const ProfileCounter &c = t->counters[op][b];
+          row.calls += c.calls.load(std::memory_order_relaxed);
+          row.nanos += c.nanos.load(std::memory_order_relaxed);
+          row.bytes += c.bytes.load(std::memory_order_relaxed);
+          row.flops += c.flops.load(std::memory_order_relaxed);
+        }
+        if (row.calls > 0)
+          rows.push_back(row);
+      }
+    }
+  }
+  std::sort(rows.begin(), rows.end(),
+            [](const Row &a, const Row &b) { return a.nanos > b.nanos; });
+
+  std::ios::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  out << "Matrix profile (inclusive times; size = larger dimension or "
+         "sample count)\n";
+  out << std::left << std::setw(19) << "operation" << std::setw(21)
+      << "size" << std::right << std::setw(10) << "calls" << std::setw(12)
+      << "total ms" << std::setw(12) << "mean us" << std::setw(10)
+      << "GFLOP/s" << std::setw(12) << "alloc MB" << "\n";
+  for (const Row &row : rows) {
+    const unsigned long long lo = 1ULL << row.bucket;
+    std::string range = "[" + std::to_string(row.bucket == 0 ? 0 : lo) +
+                        ", " + std::to_string(lo * 2) + ")";
+    out << std::left << std::setw(19) << OP_NAMES[row.op] << std::setw(21)
+        << range << std::right << std::setw(10) << row.calls << std::fixed
+        << std::setprecision(3) << std::setw(12) << row.nanos * 1e-6
+        << std::setw(12) << row.nanos * 1e-3 / row.calls
+        << std::setprecision(2) << std::setw(10);
+    if (row.flops > 0.0 && row.nanos > 0)
+      out << row.flops / row.nanos;
+    else
+      out << "-";
+    out << std::setw(12) << row.bytes / 1048576.0 << "\n";
+  }
+  out.flags(flags);
+  out.precision(precision);
+}
@@ -0,0 +1,97 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
+
+// Optional instrumentation of Matrix and Statistics operations.
+//
+// Set MATRIX_PROFILE to any value other than "0" to enable it. Every
+// instrumented operation then records its call count, wall time, floating
+// point operations and bytes of Matrix storage allocated, grouped by
+// operation and by power-of-two size bucket, and a report is printed to
+// stderr when the process exits. Profiler::report() prints it on demand.
+//
+// Counters are per thread, so recording takes no locks. Times are
+// inclusive: an operation that calls another (inverse -> LU) counts the
+// inner one in both rows. FLOPs are nominal counts, recorded by the
+// operation that does the work: determinant and inverse reuse the LU
+// factorization, whose FLOPs appear under "lu". When profiling is
+// disabled, an instrumented call costs one relaxed atomic load and a branch.
+enum class ProfileOp {
+  Multiply,
+  Elementwise,
+  Transpose,
+  Submatrix,
+  LUFactorization,
+  Determinant,
+  Inverse,
+  Solve,
+  Rref,
+  GramSchmidt,
+  RankOneUpdate,
+  Mean,
+  Variance,
+  Quantile,
+  ColumnStatistics,
+  Count
+};
+
+class Profiler {
+private:
+  static std::atomic<bool> active;
+
+public:
+  static const int SIZE_BUCKETS = 32; // bucket b holds sizes [2^b, 2^(b+1))
+
+  static bool enabled() { return active.load(std::memory_order_relaxed); }
+  static void setEnabled(bool on);
+
+  static void record(ProfileOp op, std::size_t size, long long nanos,
+                     double flops, long long bytes);
+  // Matrix storage allocated on the calling thread
+  static void addAllocation(std::size_t bytes);
+  static long long allocatedBytes();
+
+  static void report(std::ostream &out);
+  static void reset();
+  static const char *name(ProfileOp op);
+};
+
+// Records the enclosing block as one call of `op`. `size` picks the bucket
+// (the larger matrix dimension, or the number of samples).
+class ProfileScope {
+private:
+  typedef std::chrono::steady_clock Clock;
+  ProfileOp op;
+  std::size_t size;
+  double flops;
+  bool on;
+  long long bytes0;
+  Clock::time_point start;
+
+public:
+  ProfileScope(ProfileOp op, std::size_t size, double flops = 0.0)
+      : op(op), size(size), flops(flops), on(Profiler::enabled()),
+        bytes0(0) {
+    if (on) {
+      bytes0 = Profiler::allocatedBytes();
+      start = Clock::now();
+    }
+  }
+  ~ProfileScope() {
+    if (on) {
+      long long nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            Clock::now() - start)
+                            .count();
+      Profiler::record(op, size, nanos, flops,
+                       Profiler::allocatedBytes() - bytes0);
+    }
+  }
+  ProfileScope(const ProfileScope &) = delete;
+  ProfileScope &operator=(const ProfileScope &) = delete;
+};
+
+#endif
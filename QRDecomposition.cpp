@@ -0,0 +1,192 @@
+#include "QRDecomposition.h"
+#include "Gemm.h"
+#include <algorithm>
+#include <cmath>
+
+// Columns per block: wide enough for gemm to pay off, narrow enough that
+// the unblocked panel stays in cache
+const int QR_BLOCK = 32;
+
+QRDecomposition::QRDecomposition(const Matrix &A, double dropTolerance)
+    : qr(A.view()) {
+  const int n = qr.getCols();
+  for (int k = 0; k < n; k += QR_BLOCK) {
+    const int kend = std::min(n, k + QR_BLOCK);
+    const int r0 = size();
+    factorPanel(k, kend, dropTolerance);
+    if (size() > r0) {
+      blockStarts.push_back(r0);
+      if (kend < n)
+        applyBlock(r0, size(), true, qr, kend, n);
+    }
+  }
+}
+
+// Unblocked Householder on columns [col0, col1). Reflectors are applied to
+// the rest of the panel row by row, so the inner loops run along rows.
+void QRDecomposition::factorPanel(int col0, int col1, double dropTolerance) {
+  const int m = qr.getRows();
+  double *a = qr.rowPtr(0);
+  const std::size_t ld = qr.getStride();
+  std::vector<double> w(col1 - col0);
+  for (int j = col0; j < col1; j++) {
+    const int r = size();
+    if (r == m)
+      return;
+    const double alpha = a[r * ld + j];
+    double sigma = 0.0;
+    for (int i = r + 1; i < m; i++) {
+      const double x = a[i * ld + j];
+      sigma += x * x;
+    }
+    if (dropTolerance > 0.0 && alpha * alpha + sigma <= dropTolerance)
+      continue;
+
+    // H = I - t * v * v^T with v[r] = 1 maps the column onto beta * e_r
+    double t = 0.0;
+    if (sigma > 0.0) {
+      double norm = std::sqrt(alpha * alpha + sigma);
+      double beta = alpha <= 0.0 ? norm : -norm;
+      t = (beta - alpha) / beta;
+      const double scale = 1.0 / (alpha - beta);
+      for (int i = r + 1; i < m; i++)
+        a[i * ld + j] *= scale;
+      a[r * ld + j] = beta;
+    }
+    tau.push_back(t);
+    pivotCols.push_back(j);
+    if (t == 0.0 || j + 1 == col1)
+      continue;
+
+    // Rest of the panel: w = v^T * A, then A -= t * v * w^T
+    const int width = col1 - j - 1;
+    std::copy(a + r * ld + j + 1, a + r * ld + col1, w.begin());
+    for (int i = r + 1; i < m; i++) {
+      const double v = a[i * ld + j];
+      const double *row = a + i * ld + j + 1;
+      for (int c = 0; c < width; c++)
+        w[c] += v * row[c];
+    }
+    for (int c = 0; c < width; c++)
+      w[c] *= t;
+    double *top = a + r * ld + j + 1;
+    for (int c = 0; c < width; c++)
+      top[c] -= w[c];
+    for (int i = r + 1; i < m; i++) {
+      const double v = a[i * ld + j];
+      double *row = a + i * ld + j + 1;
+      for (int c = 0; c < width; c++)
+        row[c] -= v * w[c];
+    }
+  }
+}
+
+// V (rows r0.. x nb) holds reflectors r0..r1-1 with their implicit unit
+// entries, Vt is its transpose, and T is the nb x nb upper triangular
+// factor with H_r0 ... H_r1-1 = I - V T V^T.
+void QRDecomposition::buildBlock(int r0, int r1, Matrix &V, Matrix &Vt,
+                                 Matrix &T) const {
+  const int mm = qr.getRows() - r0;
+  const int nb = r1 - r0;
+  V = Matrix(mm, nb);
+  Vt = Matrix(nb, mm);
+  T = Matrix(nb, nb);
+  for (int t = 0; t < nb; t++) {
+    const int col = pivotCols[r0 + t];
+    double *vt = Vt.rowPtr(t);
+    vt[t] = 1.0;
+    for (int i = t + 1; i < mm; i++)
+      vt[i] = qr.rowPtr(r0 + i)[col];
+    for (int i = t; i < mm; i++)
+      V.rowPtr(i)[t] = vt[i];
+  }
+
+  // T(0:t, t) = -tau_t * T(0:t, 0:t) * V(:, 0:t)^T * v_t
+  std::vector<double> z(nb);
+  for (int t = 0; t < nb; t++) {
+    const double *vt = Vt.rowPtr(t);
+    for (int a = 0; a < t; a++) {
+      const double *va = Vt.rowPtr(a);
+      double dot = 0.0;
+      for (int i = t; i < mm; i++)
+        dot += va[i] * vt[i];
+      z[a] = -tau[r0 + t] * dot;
+    }
+    for (int a = 0; a < t; a++) {
+      const double *ta = T.rowPtr(a);
+      double sum = 0.0;
+      for (int b = a; b < t; b++)
+        sum += ta[b] * z[b];
+      T.rowPtr(a)[t] = sum;
+    }
+    T.rowPtr(t)[t] = tau[r0 + t];
+  }
+}
+
+// C(r0:, col0:col1) = (I - V T V^T) C, or with T^T when transposed
+void QRDecomposition::applyBlock(int r0, int r1, bool transposed, Matrix &C,
+                                 int col0, int col1) const {
+  Matrix V, Vt, T;
+  buildBlock(r0, r1, V, Vt, T);
+  const int mm = qr.getRows() - r0;
+  const int nb = r1 - r0;
+  const int nc = col1 - col0;
+  double *c = C.rowPtr(r0) + col0;
+  const int ldc = C.getStride();
+
+  // W = V^T * C
+  Matrix W(nb, nc);
+  gemm(nb, nc, mm, Vt.rowPtr(0), Vt.getStride(), c, ldc, W.rowPtr(0),
+       W.getStride());
+
+  // X = -T * W (or -T^T * W); T is triangular and small
+  Matrix X(nb, nc);
+  for (int a = 0; a < nb; a++) {
+    double *x = X.rowPtr(a);
+    const int first = transposed ? 0 : a;
+    const int last = transposed ? a + 1 : nb;
+    for (int b = first; b < last; b++) {
+      const double f = transposed ? -T.rowPtr(b)[a] : -T.rowPtr(a)[b];
+      const double *wb = W.rowPtr(b);
+      for (int j = 0; j < nc; j++)
+        x[j] += f * wb[j];
+    }
+  }
+
+  // C += V * X
+  gemm(mm, nc, nb, V.rowPtr(0), V.getStride(), X.rowPtr(0), X.getStride(),
+       c, ldc);
+}
+
+// Q = H_0 H_1 ... applied to the first size() columns of the identity,
+// one block at a time from the last
+Matrix QRDecomposition::getQ() const {
+  const int m = qr.getRows();
+  const int k = size();
+  if (k == 0)
+    return Matrix();
+  Matrix Q(m, k);
+  for (int i = 0; i < k; i++)
+    Q.rowPtr(i)[i] = 1.0;
+  for (int b = static_cast<int>(blockStarts.size()) - 1; b >= 0; b--) {
+    const int r0 = blockStarts[b];
+    const int r1 = b + 1 < static_cast<int>(blockStarts.size())
+                       ? blockStarts[b + 1]
+                       : k;
+    applyBlock(r0, r1, false, Q, r0, k);
+  }
+  return Q;
+}
+
+Matrix QRDecomposition::getR() const {
+  const int k = size();
+  if (k == 0)
+    return Matrix();
+  Matrix R(k, qr.getCols());
+  for (int t = 0; t < k; t++) {
+    const double *src = qr.rowPtr(t);
+    std::copy(src + pivotCols[t], src + qr.getCols(),
+              R.rowPtr(t) + pivotCols[t]);
+  }
+  return R;
+}
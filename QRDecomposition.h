@@ -0,0 +1,40 @@
+#ifndef QR_DECOMPOSITION_H
+#define QR_DECOMPOSITION_H
+
+#include "Matrix.h"
+#include <vector>
+
+// Householder QR: A = Q * R, computed in blocks of columns. Each block of
+// reflectors is aggregated in compact WY form (H1 ... Hk = I - V T V^T)
+// so the trailing columns are updated with two gemm calls instead of one
+// rank-1 update per reflector.
+//
+// With dropTolerance > 0, a column whose remaining norm^2 is at most the
+// tolerance gets no reflector: Q then spans exactly the independent
+// columns (in order) and R is in row echelon form. This is what
+// Matrix::gramSchmidt uses.
+class QRDecomposition {
+private:
+  Matrix qr; // R on and above the pivots, reflectors below them
+  std::vector<double> tau;
+  std::vector<int> pivotCols;   // column that produced each reflector
+  std::vector<int> blockStarts; // first reflector of each block
+
+  void factorPanel(int col0, int col1, double dropTolerance);
+  void buildBlock(int r0, int r1, Matrix &V, Matrix &Vt, Matrix &T) const;
+  void applyBlock(int r0, int r1, bool transposed, Matrix &C, int col0,
+                  int col1) const;
+
+public:
+  explicit QRDecomposition(const Matrix &A, double dropTolerance = 0.0);
+
+  // Number of reflectors: min(rows, cols), or the numerical rank when
+  // columns are dropped
+  int size() const { return static_cast<int>(tau.size()); }
+  const std::vector<int> &getPivotColumns() const { return pivotCols; }
+
+  Matrix getQ() const; // rows x size(), orthonormal columns
+  Matrix getR() const; // size() x cols, upper triangular (echelon)
+};
+
+#endif
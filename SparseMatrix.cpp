@@ -0,0 +1,399 @@
+#include "SparseMatrix.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <string>
+
+// Constructors and conversion
+
+SparseMatrix::SparseMatrix() : rows(0), cols(0), layout(CSR), offsets(1, 0) {}
+
+SparseMatrix::SparseMatrix(int r, int c, Layout l)
+    : rows(r), cols(c), layout(l) {
+  if (r <= 0 || c <= 0)
+    throw std::invalid_argument("Matrix dimensions must be positive");
+  offsets.assign(majorSize() + 1, 0);
+}
+
+SparseMatrix SparseMatrix::fromDense(const Matrix &m, Layout l,
+                                     double tolerance) {
+  SparseMatrix csr(m.getRows(), m.getCols(), CSR);
+  for (int i = 0; i < m.getRows(); i++) {
+    const double *row = m.rowPtr(i);
+    for (int j = 0; j < m.getCols(); j++) {
+      if (std::abs(row[j]) > tolerance) {
+        csr.indices.push_back(j);
+        csr.values.push_back(row[j]);
+      }
+    }
+    csr.offsets[i + 1] = static_cast<int>(csr.values.size());
+  }
+  return l == CSR ? csr : csr.toLayout(CSC);
+}
+
+SparseMatrix SparseMatrix::fromTriplets(int r, int c,
+                                        const std::vector<int> &rowIdx,
+                                        const std::vector<int> &colIdx,
+                                        const std::vector<double> &vals,
+                                        Layout l) {
+  if (rowIdx.size() != colIdx.size() || rowIdx.size() != vals.size())
+    throw std::invalid_argument("Triplet arrays must have the same length");
+  SparseMatrix result(r, c, l);
+  const std::vector<int> &major = l == CSR ? rowIdx : colIdx;
+  const std::vector<int> &minor = l == CSR ? colIdx : rowIdx;
+  for (std::size_t k = 0; k < vals.size(); k++) {
+    if (rowIdx[k] < 0 || rowIdx[k] >= r || colIdx[k] < 0 || colIdx[k] >= c)
+      throw std::out_of_range("Matrix indices out of range");
+    result.offsets[major[k] + 1]++;
+  }
+  std::partial_sum(result.offsets.begin(), result.offsets.end(),
+                   result.offsets.begin());
+
+  // Counting sort by major index, then sort and sum each segment
+  std::vector<int> next(result.offsets.begin(), result.offsets.end() - 1);
+  std::vector<std::pair<int, double>> entries(vals.size());
+  for (std::size_t k = 0; k < vals.size(); k++)
+    entries[next[major[k]]++] = std::make_pair(minor[k], vals[k]);
+  int out = 0;
+  for (int m = 0; m < result.majorSize(); m++) {
+    auto first = entries.begin() + result.offsets[m];
+    auto last = entries.begin() + result.offsets[m + 1];
+    std::sort(first, last, [](const std::pair<int, double> &a,
+                              const std::pair<int, double> &b) {
+      return a.first < b.first;
+    });
+    result.offsets[m] = out;
+    for (auto it = first; it != last; ++it) {
+      if (out > result.offsets[m] && entries[out - 1].first == it->first)
+        entries[out - 1].second += it->second;
+      else
+        entries[out++] = *it;
+    }
+  }
+  result.offsets[result.majorSize()] = out;
+  result.indices.resize(out);
+  result.values.resize(out);
+  for (int k = 0; k < out; k++) {
+    result.indices[k] = entries[k].first;
+    result.values[k] = entries[k].second;
+  }
+  return result;
+}
+
+Matrix SparseMatrix::toDense() const {
+  Matrix m(rows, cols);
+  for (int a = 0; a < majorSize(); a++) {
+    for (int k = offsets[a]; k < offsets[a + 1]; k++) {
+      if (layout == CSR)
+        m.rowPtr(a)[indices[k]] = values[k];
+      else
+        m.rowPtr(indices[k])[a] = values[k];
+    }
+  }
+  return m;
+}
+
+// Counting sort on the minor index; segments stay sorted because majors
+// are visited in order
+SparseMatrix SparseMatrix::toLayout(Layout l) const {
+  if (l == layout)
+    return *this;
+  SparseMatrix result(rows, cols, l);
+  result.indices.resize(indices.size());
+  result.values.resize(values.size());
+  for (int idx : indices)
+    result.offsets[idx + 1]++;
+  std::partial_sum(result.offsets.begin(), result.offsets.end(),
+                   result.offsets.begin());
+  std::vector<int> next(result.offsets.begin(), result.offsets.end() - 1);
+  for (int a = 0; a < majorSize(); a++) {
+    for (int k = offsets[a]; k < offsets[a + 1]; k++) {
+      int pos = next[indices[k]]++;
+      result.indices[pos] = a;
+      result.values[pos] = values[k];
+    }
+  }
+  return result;
+}
+
+double SparseMatrix::get(int i, int j) const {
+  if (i < 0 || i >= rows || j < 0 || j >= cols)
+    throw std::out_of_range("Matrix indices out of range");
+  int a = layout == CSR ? i : j;
+  int b = layout == CSR ? j : i;
+  auto first = indices.begin() + offsets[a];
+  auto last = indices.begin() + offsets[a + 1];
+  auto it = std::lower_bound(first, last, b);
+  return it != last && *it == b ? values[it - indices.begin()] : 0.0;
+}
+
+// Arithmetic
+
+// CSR of A holds exactly the CSC of A^T
+SparseMatrix SparseMatrix::transpose() const {
+  SparseMatrix result = *this;
+  std::swap(result.rows, result.cols);
+  result.layout = layout == CSR ? CSC : CSR;
+  return result;
+}
+
+std::vector<double> SparseMatrix::multiply(const VectorView &x) const {
+  if (x.size() != cols)
+    throw std::invalid_argument("Invalid dimensions for matrix multiplication");
+  std::vector<double> y(rows, 0.0);
+  if (layout == CSR) {
+    long long perRow = static_cast<long long>(values.size()) / rows + 1;
+    parallelRange(rows, perRow, [&](int first, int last) {
+      for (int i = first; i < last; i++) {
+        double sum = 0.0;
+        for (int k = offsets[i]; k < offsets[i + 1]; k++)
+          sum += values[k] * x[indices[k]];
+        y[i] = sum;
+      }
+    });
+  } else {
+    for (int j = 0; j < cols; j++) {
+      const double xj = x[j];
+      if (xj == 0.0)
+        continue;
+      for (int k = offsets[j]; k < offsets[j + 1]; k++)
+        y[indices[k]] += values[k] * xj;
+    }
+  }
+  return y;
+}
+
+// Each nonzero A(i, k) adds A(i, k) * B.row(k) to C.row(i): contiguous
+// row updates, independent across rows of C
+Matrix SparseMatrix::operator*(const Matrix &B) const {
+  if (cols != B.getRows())
+    throw std::invalid_argument("Invalid dimensions for matrix multiplication");
+  if (layout == CSC)
+    return toLayout(CSR) * B;
+  const int n = B.getCols();
+  Matrix C(rows, n);
+  long long perRow = (static_cast<long long>(values.size()) / rows + 1) * n;
+  parallelRange(rows, perRow, [&](int first, int last) {
+    for (int i = first; i < last; i++) {
+      double *c = C.rowPtr(i);
+      for (int k = offsets[i]; k < offsets[i + 1]; k++) {
+        const double a = values[k];
+        const double *b = B.rowPtr(indices[k]);
+        for (int j = 0; j < n; j++)
+          c[j] += a * b[j];
+      }
+    }
+  });
+  return C;
+}
+
+// Merge of two sorted segments per major index; exact cancellations are
+// not stored
+SparseMatrix SparseMatrix::combine(const SparseMatrix &other,
+                                   double sign) const {
+  if (rows != other.rows || cols != other.cols)
+    throw std::invalid_argument(
+        std::string("Matrix dimensions must match for ") +
+        (sign > 0 ? "addition" : "subtraction"));
+  if (other.layout != layout)
+    return combine(other.toLayout(layout), sign);
+  SparseMatrix result(rows, cols, layout);
+  result.indices.reserve(indices.size() + other.indices.size());
+  result.values.reserve(values.size() + other.values.size());
+  for (int a = 0; a < majorSize(); a++) {
+    int p = offsets[a], pe = offsets[a + 1];
+    int q = other.offsets[a], qe = other.offsets[a + 1];
+    while (p < pe || q < qe) {
+      int idx;
+      double v;
+      if (q == qe || (p < pe && indices[p] < other.indices[q])) {
+        idx = indices[p];
+        v = values[p++];
+      } else if (p == pe || other.indices[q] < indices[p]) {
+        idx = other.indices[q];
+        v = sign * other.values[q++];
+      } else {
+        idx = indices[p];
+        v = values[p++] + sign * other.values[q++];
+      }
+      if (v != 0.0) {
+        result.indices.push_back(idx);
+        result.values.push_back(v);
+      }
+    }
+    result.offsets[a + 1] = static_cast<int>(result.values.size());
+  }
+  return result;
+}
+
+SparseMatrix SparseMatrix::operator+(const SparseMatrix &other) const {
+  return combine(other, 1.0);
+}
+
+SparseMatrix SparseMatrix::operator-(const SparseMatrix &other) const {
+  return combine(other, -1.0);
+}
+
+SparseMatrix SparseMatrix::operator*(double scalar) const {
+  SparseMatrix result = *this;
+  if (scalar == 0.0) {
+    std::fill(result.offsets.begin(), result.offsets.end(), 0);
+    result.indices.clear();
+    result.values.clear();
+    return result;
+  }
+  for (double &v : result.values)
+    v *= scalar;
+  return result;
+}
+
+// Elimination
+
+// One row of the working matrix, sorted by column
+struct SparseRow {
+  std::vector<int> idx;
+  std::vector<double> val;
+};
+
+static std::vector<SparseRow> toRows(const SparseMatrix &csr) {
+  const std::vector<int> &off = csr.getOffsets();
+  std::vector<SparseRow> result(csr.getRows());
+  for (int i = 0; i < csr.getRows(); i++) {
+    for (int k = off[i]; k < off[i + 1]; k++) {
+      if (std::abs(csr.getValues()[k]) >= EPSILON) {
+        result[i].idx.push_back(csr.getIndices()[k]);
+        result[i].val.push_back(csr.getValues()[k]);
+      }
+    }
+  }
+  return result;
+}
+
+// row -= factor * pivot. Entries that fall below EPSILON are dropped,
+// which is what removes the eliminated column itself.
+static void eliminate(SparseRow &row, const SparseRow &pivot, double factor,
+                      SparseRow &scratch) {
+  scratch.idx.clear();
+  scratch.val.clear();
+  std::size_t p = 0, q = 0;
+  while (p < row.idx.size() || q < pivot.idx.size()) {
+    int idx;
+    double v;
+    if (q == pivot.idx.size() ||
+        (p < row.idx.size() && row.idx[p] < pivot.idx[q])) {
+      idx = row.idx[p];
+      v = row.val[p++];
+    } else if (p == row.idx.size() || pivot.idx[q] < row.idx[p]) {
+      idx = pivot.idx[q];
+      v = -factor * pivot.val[q++];
+    } else {
+      idx = row.idx[p];
+      v = row.val[p++] - factor * pivot.val[q++];
+    }
+    if (std::abs(v) >= EPSILON) {
+      scratch.idx.push_back(idx);
+      scratch.val.push_back(v);
+    }
+  }
+  std::swap(row.idx, scratch.idx);
+  std::swap(row.val, scratch.val);
+}
+
+// Gaussian elimination with rows bucketed by their leading column, so each
+// column only touches the rows that actually start there. The pivot is the
+// shortest candidate whose leading value is within 10x of the largest
+// (threshold pivoting keeps fill-in low). Returns the normalized pivot
+// rows in column order.
+static std::vector<SparseRow> forwardEliminate(std::vector<SparseRow> work,
+                                               int cols,
+                                               std::vector<int> &pivotCols) {
+  std::vector<std::vector<int>> bucket(cols);
+  for (int i = 0; i < static_cast<int>(work.size()); i++) {
+    if (!work[i].idx.empty())
+      bucket[work[i].idx[0]].push_back(i);
+  }
+  std::vector<SparseRow> pivots;
+  SparseRow scratch;
+  for (int c = 0; c < cols; c++) {
+    std::vector<int> candidates;
+    candidates.swap(bucket[c]);
+    if (candidates.empty())
+      continue;
+    double maxLead = 0.0;
+    for (int i : candidates)
+      maxLead = std::max(maxLead, std::abs(work[i].val[0]));
+    int best = -1;
+    for (int i : candidates) {
+      if (std::abs(work[i].val[0]) >= 0.1 * maxLead &&
+          (best < 0 || work[i].idx.size() < work[best].idx.size()))
+        best = i;
+    }
+
+    SparseRow pivot = std::move(work[best]);
+    const double inv = 1.0 / pivot.val[0];
+    for (double &v : pivot.val)
+      v *= inv;
+    pivot.val[0] = 1.0;
+    for (int i : candidates) {
+      if (i == best)
+        continue;
+      eliminate(work[i], pivot, work[i].val[0], scratch);
+      if (!work[i].idx.empty())
+        bucket[work[i].idx[0]].push_back(i);
+    }
+    pivots.push_back(std::move(pivot));
+    pivotCols.push_back(c);
+  }
+  return pivots;
+}
+
+SparseMatrix SparseMatrix::rref() const {
+  std::vector<int> pivotCols;
+  std::vector<SparseRow> pivots =
+      forwardEliminate(toRows(toLayout(CSR)), cols, pivotCols);
+  const int rank = static_cast<int>(pivots.size());
+
+  // Back substitution. A reduced pivot row has nonzeros only in its own
+  // column and in non-pivot columns, so clearing pivot column k never
+  // creates entries in other pivot columns: the rows that need clearing
+  // can be listed once, up front.
+  std::vector<int> pivotOf(cols, -1);
+  for (int k = 0; k < rank; k++)
+    pivotOf[pivotCols[k]] = k;
+  std::vector<std::vector<int>> above(rank);
+  for (int j = 0; j < rank; j++) {
+    for (std::size_t t = 1; t < pivots[j].idx.size(); t++) {
+      int k = pivotOf[pivots[j].idx[t]];
+      if (k >= 0)
+        above[k].push_back(j);
+    }
+  }
+  SparseRow scratch;
+  for (int k = rank - 1; k >= 0; k--) {
+    for (int j : above[k]) {
+      SparseRow &row = pivots[j];
+      auto it = std::lower_bound(row.idx.begin(), row.idx.end(), pivotCols[k]);
+      if (it != row.idx.end() && *it == pivotCols[k])
+        eliminate(row, pivots[k], row.val[it - row.idx.begin()], scratch);
+    }
+  }
+
+  SparseMatrix result(rows, cols, CSR);
+  for (int k = 0; k < rank; k++) {
+    result.indices.insert(result.indices.end(), pivots[k].idx.begin(),
+                          pivots[k].idx.end());
+    result.values.insert(result.values.end(), pivots[k].val.begin(),
+                         pivots[k].val.end());
+    result.offsets[k + 1] = static_cast<int>(result.values.size());
+  }
+  for (int i = rank; i < rows; i++)
+    result.offsets[i + 1] = static_cast<int>(result.values.size());
+  return result;
+}
+
+int SparseMatrix::rank() const {
+  std::vector<int> pivotCols;
+  return static_cast<int>(
+      forwardEliminate(toRows(toLayout(CSR)), cols, pivotCols).size());
+}
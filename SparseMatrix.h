@@ -0,0 +1,70 @@
+#ifndef SPARSE_MATRIX_H
+#define SPARSE_MATRIX_H
+
+#include "Matrix.h"
+#include <vector>
+
+// Compressed sparse matrix in CSR (row-major) or CSC (column-major) layout.
+// Only nonzeros are stored: for each major index m (row in CSR, column in
+// CSC) its entries are indices/values[offsets[m] .. offsets[m + 1]),
+// sorted by minor index. Memory and the cost of every operation scale with
+// the number of nonzeros.
+class SparseMatrix {
+public:
+  enum Layout { CSR, CSC };
+
+private:
+  int rows;
+  int cols;
+  Layout layout;
+  std::vector<int> offsets; // majorSize() + 1 entries
+  std::vector<int> indices; // minor index of each nonzero
+  std::vector<double> values;
+
+  int majorSize() const { return layout == CSR ? rows : cols; }
+  int minorSize() const { return layout == CSR ? cols : rows; }
+  SparseMatrix combine(const SparseMatrix &other, double sign) const;
+
+public:
+  SparseMatrix();
+  SparseMatrix(int r, int c, Layout l = CSR);
+
+  // Conversion. Entries with |value| <= tolerance are dropped.
+  static SparseMatrix fromDense(const Matrix &m, Layout l = CSR,
+                                double tolerance = 0.0);
+  // Builds from (row, col, value) triplets in any order; duplicates are
+  // summed
+  static SparseMatrix fromTriplets(int r, int c, const std::vector<int> &rowIdx,
+                                   const std::vector<int> &colIdx,
+                                   const std::vector<double> &vals,
+                                   Layout l = CSR);
+  Matrix toDense() const;
+  SparseMatrix toLayout(Layout l) const;
+
+  // Accessors
+  int getRows() const { return rows; }
+  int getCols() const { return cols; }
+  Layout getLayout() const { return layout; }
+  int nonZeros() const { return static_cast<int>(values.size()); }
+  double get(int i, int j) const; // O(log nnz of the row/column)
+  const std::vector<int> &getOffsets() const { return offsets; }
+  const std::vector<int> &getIndices() const { return indices; }
+  const std::vector<double> &getValues() const { return values; }
+
+  // Operations
+  SparseMatrix transpose() const; // reinterprets the layout, no reordering
+  std::vector<double> multiply(const VectorView &x) const; // y = A * x
+  Matrix operator*(const Matrix &B) const;                 // sparse * dense
+  SparseMatrix operator+(const SparseMatrix &other) const;
+  SparseMatrix operator-(const SparseMatrix &other) const;
+  SparseMatrix operator*(double scalar) const;
+
+  // Elimination on sparse rows, dropping entries below EPSILON like
+  // Matrix::rref/rank. The pivots are chosen to limit fill-in, so results
+  // match Matrix up to rounding; on ill-conditioned matrices the rank can
+  // differ (benchmark sparse compares the two).
+  SparseMatrix rref() const;
+  int rank() const;
+};
+
+#endif
@@ -1,37 +1,465 @@
 #ifndef STATISTICS_H
 #define STATISTICS_H
 
+#include "MatrixView.h"
+#include "Profiler.h"
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
 #include <vector>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Streaming accumulator for count, mean, variance, min and max.
+//
+// Values can be added one at a time (Welford's update) or in chunks.
+// Accumulators built on separate threads or data partitions can be
+// combined with merge() (Chan et al.), so nothing has to be buffered.
+class RunningStatistics {
+  friend class Statistics;
+
+private:
+  std::size_t count;
+  double mean;
+  double m2; // sum of squared deviations from the mean
+  double minValue;
+  double maxValue;
+
+public:
+  RunningStatistics()
+      : count(0), mean(0.0), m2(0.0), minValue(0.0), maxValue(0.0) {}
+
+  void add(double value) {
+    count++;
+    const double delta = value - mean;
+    mean += delta / static_cast<double>(count);
+    m2 += delta * (value - mean);
+    if (count == 1) {
+      minValue = maxValue = value;
+    } else {
+      minValue = std::min(minValue, value);
+      maxValue = std::max(maxValue, value);
+    }
+  }
+
+  // Elements summarised per block by add(const double *, size_t)
+  static const std::size_t ADD_BLOCK = 256;
+
+  // Adds a chunk in one sweep. Each block of ADD_BLOCK values is summed
+  // relative to its first value, which keeps the sum of squares free of
+  // cancellation, and then merged (Chan et al.). Faster and more accurate
+  // than per-element updates.
+  void add(const double *values, std::size_t n) {
+    for (std::size_t start = 0; start < n; start += ADD_BLOCK) {
+      const std::size_t m = std::min(ADD_BLOCK, n - start);
+      const double *x = values + start;
+      const double shift = x[0];
+      double sum = 0.0, squares = 0.0, lo = shift, hi = shift;
+      std::size_t i = 0;
+#ifdef __SSE2__
+      // Two vectors of two lanes; min/max operands are ordered like
+      // std::min(lo, x), so a NaN input is skipped the same way
+      const __m128d s = _mm_set1_pd(shift);
+      __m128d sum0 = _mm_setzero_pd(), sum1 = sum0, sq0 = sum0, sq1 = sum0;
+      __m128d lo0 = s, lo1 = s, hi0 = s, hi1 = s;
+      for (; i + 4 <= m; i += 4) {
+        __m128d a = _mm_loadu_pd(x + i);
+        __m128d b = _mm_loadu_pd(x + i + 2);
+        lo0 = _mm_min_pd(a, lo0);
+        lo1 = _mm_min_pd(b, lo1);
+        hi0 = _mm_max_pd(a, hi0);
+        hi1 = _mm_max_pd(b, hi1);
+        a = _mm_sub_pd(a, s);
+        b = _mm_sub_pd(b, s);
+        sum0 = _mm_add_pd(sum0, a);
+        sum1 = _mm_add_pd(sum1, b);
+        sq0 = _mm_add_pd(sq0, _mm_mul_pd(a, a));
+        sq1 = _mm_add_pd(sq1, _mm_mul_pd(b, b));
+      }
+      double lanes[8];
+      _mm_storeu_pd(lanes, _mm_add_pd(sum0, sum1));
+      _mm_storeu_pd(lanes + 2, _mm_add_pd(sq0, sq1));
+      _mm_storeu_pd(lanes + 4, _mm_min_pd(lo1, lo0));
+      _mm_storeu_pd(lanes + 6, _mm_max_pd(hi1, hi0));
+      sum = lanes[0] + lanes[1];
+      squares = lanes[2] + lanes[3];
+      lo = std::min(lanes[4], lanes[5]);
+      hi = std::max(lanes[6], lanes[7]);
+#endif
+      for (; i < m; i++) {
+        const double d = x[i] - shift;
+        sum += d;
+        squares += d * d;
+        lo = std::min(lo, x[i]);
+        hi = std::max(hi, x[i]);
+      }
+      RunningStatistics block;
+      block.count = m;
+      block.mean = shift + sum / static_cast<double>(m);
+      block.m2 = std::max(0.0, squares - sum * sum / static_cast<double>(m));
+      block.minValue = lo;
+      block.maxValue = hi;
+      merge(block);
+    }
+  }
+
+  void add(const std::vector<double> &values) {
+    add(values.data(), values.size());
+  }
+
+  void add(const VectorView &values) {
+    if (values.isContiguous()) {
+      add(values.data(), values.size());
+      return;
+    }
+    for (int i = 0; i < values.size(); i++)
+      add(values[i]);
+  }
+
+  void merge(const RunningStatistics &other) {
+    if (other.count == 0)
+      return;
+    if (count == 0) {
+      *this = other;
+      return;
+    }
+    const double total = static_cast<double>(count + other.count);
+    const double delta = other.mean - mean;
+    mean += delta * static_cast<double>(other.count) / total;
+    m2 += other.m2 + delta * delta * static_cast<double>(count) *
+                         static_cast<double>(other.count) / total;
+    count += other.count;
+    minValue = std::min(minValue, other.minValue);
+    maxValue = std::max(maxValue, other.maxValue);
+  }
+
+  void reset() { *this = RunningStatistics(); }
+
+  // Getters (0.0 while empty, matching the Statistics functions)
+  std::size_t getCount() const { return count; }
+  double getMean() const { return mean; }
+  // Sample variance with Bessel's correction (n - 1)
+  double getVariance() const {
+    return count < 2 ? 0.0 : m2 / static_cast<double>(count - 1);
+  }
+  double getStandardDeviation() const { return std::sqrt(getVariance()); }
+  double getMin() const { return minValue; }
+  double getMax() const { return maxValue; }
+};
+
+// Bounded-memory, mergeable quantile sketch (merging t-digest, Dunning).
+//
+// Values are buffered and periodically compressed into at most about
+// `compression` weighted centroids, using the k1 scale function
+// k(q) = compression / (2 pi) * asin(2q - 1). That function keeps the
+// clusters near the tails small, which is what makes p99/p999 accurate.
+//
+// Error bound: a centroid centred at quantile q spans at most
+// 2 pi sqrt(q (1 - q)) / compression of the rank range, and quantile()
+// interpolates inside it, so the rank error of quantile(q) is at most about
+// pi sqrt(q (1 - q)) / compression. For the default compression of 500 that
+// is +-0.31% of ranks at the median, +-0.19% at p90, +-0.06% at p99 and
+// +-0.02% at p999. Observed errors are usually ten times smaller. Memory is
+// about `compression` centroids plus a 5 * compression value buffer. The
+// minimum and maximum are tracked exactly.
+class QuantileSketch {
+private:
+  struct Centroid {
+    double mean;
+    double weight;
+    bool operator<(const Centroid &other) const { return mean < other.mean; }
+  };
+
+  double compression;
+  std::vector<Centroid> centroids; // sorted by mean
+  std::vector<double> buffer;      // raw values not yet compressed
+  std::vector<Centroid> incoming;  // centroids received through merge()
+  std::vector<Centroid> scratch;
+  std::size_t bufferLimit;
+  double totalWeight; // weight held in `centroids`
+  double minValue;
+  double maxValue;
+  std::size_t count;
+
+  // k1 scale function and its inverse (clamped to [0, 1])
+  double scale(double q) const {
+    const double pi = 3.14159265358979323846;
+    return compression / (2.0 * pi) * std::asin(2.0 * q - 1.0);
+  }
+  double quantileLimit(double k) const {
+    const double pi = 3.14159265358979323846;
+    const double angle = std::min(k * 2.0 * pi / compression, pi / 2.0);
+    return (std::sin(angle) + 1.0) / 2.0;
+  }
+
+public:
+  explicit QuantileSketch(double compression = 500.0)
+      : compression(std::max(compression, 10.0)),
+        bufferLimit(static_cast<std::size_t>(this->compression) * 5),
+        totalWeight(0.0), minValue(0.0), maxValue(0.0), count(0) {
+    buffer.reserve(bufferLimit);
+  }
+
+  void add(double value) {
+    if (count == 0) {
+      minValue = maxValue = value;
+    } else {
+      minValue = std::min(minValue, value);
+      maxValue = std::max(maxValue, value);
+    }
+    count++;
+    buffer.push_back(value);
+    if (buffer.size() >= bufferLimit)
+      compress();
+  }
+
+  void add(const double *values, std::size_t n) {
+    for (std::size_t i = 0; i < n; i++)
+      add(values[i]);
+  }
+
+  void add(const std::vector<double> &values) {
+    add(values.data(), values.size());
+  }
+
+  void add(const VectorView &values) {
+    for (int i = 0; i < values.size(); i++)
+      add(values[i]);
+  }
+
+  void merge(const QuantileSketch &other) {
+    if (other.count == 0)
+      return;
+    if (count == 0) {
+      minValue = other.minValue;
+      maxValue = other.maxValue;
+    } else {
+      minValue = std::min(minValue, other.minValue);
+      maxValue = std::max(maxValue, other.maxValue);
+    }
+    count += other.count;
+    incoming.insert(incoming.end(), other.centroids.begin(),
+                    other.centroids.end());
+    incoming.insert(incoming.end(), other.incoming.begin(),
+                    other.incoming.end());
+    buffer.insert(buffer.end(), other.buffer.begin(), other.buffer.end());
+    compress();
+  }
+
+  // Folds buffered values into the centroids: sort the buffer, then one
+  // linear merge with the existing centroids
+  void compress() {
+    if (buffer.empty() && incoming.empty())
+      return;
+    std::sort(buffer.begin(), buffer.end());
+    if (!incoming.empty()) {
+      incoming.insert(incoming.end(), centroids.begin(), centroids.end());
+      std::sort(incoming.begin(), incoming.end());
+      centroids.swap(incoming);
+      incoming.clear();
+    }
+    double total = static_cast<double>(buffer.size());
+    for (const Centroid &c : centroids)
+      total += c.weight;
+
+    // Visits buffered values and existing centroids in order of mean
+    std::size_t i = 0, j = 0;
+    auto next = [&](Centroid &c) {
+      if (i < buffer.size() &&
+          (j == centroids.size() || buffer[i] < centroids[j].mean)) {
+        c = {buffer[i++], 1.0};
+        return true;
+      }
+      if (j < centroids.size()) {
+        c = centroids[j++];
+        return true;
+      }
+      return false;
+    };
+
+    scratch.clear();
+    Centroid current, item;
+    next(current);
+    double weightSoFar = 0.0;
+    double weightLimit = total * quantileLimit(scale(0.0) + 1.0);
+    while (next(item)) {
+      if (weightSoFar + current.weight + item.weight <= weightLimit) {
+        current.weight += item.weight;
+        current.mean += (item.mean - current.mean) * item.weight /
+                        current.weight;
+      } else {
+        weightSoFar += current.weight;
+        scratch.push_back(current);
+        weightLimit =
+            total * quantileLimit(scale(weightSoFar / total) + 1.0);
+        current = item;
+      }
+    }
+    scratch.push_back(current);
+    centroids.swap(scratch);
+    totalWeight = total;
+    buffer.clear();
+  }
+
+  // Estimated q-quantile (0 <= q <= 1); 0.0 while empty
+  double quantile(double q) const {
+    if (!buffer.empty() || !incoming.empty()) {
+      QuantileSketch flushed = *this;
+      flushed.compress();
+      return flushed.quantile(q);
+    }
+    if (centroids.empty())
+      return 0.0;
+    q = std::min(std::max(q, 0.0), 1.0);
+    if (q == 0.0)
+      return minValue;
+    if (q == 1.0)
+      return maxValue;
+
+    // Centroid i is centred at cumulative weight `center`; interpolate
+    // between neighbouring centres, and towards min/max at the ends
+    const double target = q * totalWeight;
+    const Centroid &first = centroids.front();
+    if (target < first.weight / 2.0) {
+      return minValue +
+             (first.mean - minValue) * target / (first.weight / 2.0);
+    }
+    double center = first.weight / 2.0;
+    for (std::size_t i = 0; i + 1 < centroids.size(); i++) {
+      const double nextCenter =
+          center + (centroids[i].weight + centroids[i + 1].weight) / 2.0;
+      if (target <= nextCenter) {
+        const double z = (target - center) / (nextCenter - center);
+        return centroids[i].mean +
+               z * (centroids[i + 1].mean - centroids[i].mean);
+      }
+      center = nextCenter;
+    }
+    const Centroid &last = centroids.back();
+    const double remaining = totalWeight - center;
+    return last.mean + (maxValue - last.mean) * (target - center) /
+                           std::max(remaining, 1e-300);
+  }
+
+  double median() const { return quantile(0.5); }
+
+  // Getters
+  std::size_t getCount() const { return count; }
+  double getMin() const { return minValue; }
+  double getMax() const { return maxValue; }
+  std::size_t centroidCount() const {
+    return centroids.size() + incoming.size();
+  }
+};
 
 class Statistics {
 public:
-  static double calculateMean(const std::vector<double> &data) {
+  // The VectorView overloads take rows/columns of a Matrix (rowView,
+  // colView) or any strided slice without copying it
+  static double calculateMean(const VectorView &data) {
+    ProfileScope profile(ProfileOp::Mean, data.size(), data.size());
     if (data.empty())
       return 0.0;
     double sum = 0.0;
-    for (double val : data) {
-      sum += val;
+    for (int i = 0; i < data.size(); i++) {
+      sum += data[i];
     }
     return sum / static_cast<double>(data.size());
   }
 
+  static double calculateMean(const std::vector<double> &data) {
+    return calculateMean(VectorView(data));
+  }
+
+  static double calculateVariance(const VectorView &data) {
+    ProfileScope profile(ProfileOp::Variance, data.size(), 4.0 * data.size());
+    RunningStatistics stats;
+    stats.add(data);
+    return stats.getVariance();
+  }
+
   static double calculateVariance(const std::vector<double> &data) {
-    if (data.size() < 2)
-      return 0.0;
-    double mean = calculateMean(data);
-    double sumSqDiff = 0.0;
-    for (double val : data) {
-      double diff = val - mean;
-      sumSqDiff += diff * diff;
-    }
-    return sumSqDiff / static_cast<double>(data.size() - 1);
+    return calculateVariance(VectorView(data));
   }
 
-  static double calculateStandardDeviation(const std::vector<double> &data) {
+  static double calculateStandardDeviation(const VectorView &data) {
     return std::sqrt(calculateVariance(data));
   }
+
+  static double calculateStandardDeviation(const std::vector<double> &data) {
+    return calculateStandardDeviation(VectorView(data));
+  }
+
+  // Statistics of every column in one row-major pass over the matrix. The
+  // Welford update runs across a whole row at a time, so the inner loop is
+  // contiguous and there are no per-column copies.
+  static std::vector<RunningStatistics> columnStatistics(const MatrixView &m) {
+    const int cols = m.getCols();
+    const double samples = double(m.getRows()) * cols;
+    ProfileScope profile(ProfileOp::ColumnStatistics,
+                         static_cast<std::size_t>(samples), 6.0 * samples);
+    std::vector<RunningStatistics> result(cols);
+    if (m.getRows() == 0 || cols == 0)
+      return result;
+    std::vector<double> mean(m.rowPtr(0), m.rowPtr(0) + cols);
+    std::vector<double> m2(cols, 0.0), lo(mean), hi(mean);
+    for (int i = 1; i < m.getRows(); i++) {
+      const double *row = m.rowPtr(i);
+      const double invN = 1.0 / static_cast<double>(i + 1);
+      for (int j = 0; j < cols; j++) {
+        const double delta = row[j] - mean[j];
+        mean[j] += delta * invN;
+        m2[j] += delta * (row[j] - mean[j]);
+        lo[j] = std::min(lo[j], row[j]);
+        hi[j] = std::max(hi[j], row[j]);
+      }
+    }
+    for (int j = 0; j < cols; j++) {
+      result[j].count = m.getRows();
+      result[j].mean = mean[j];
+      result[j].m2 = m2[j];
+      result[j].minValue = lo[j];
+      result[j].maxValue = hi[j];
+    }
+    return result;
+  }
+
+  // Exact q-quantile (nearest rank) by selection on a copy, O(n) on average
+  static double calculateQuantile(const VectorView &data, double q) {
+    ProfileScope profile(ProfileOp::Quantile, data.size());
+    if (data.empty())
+      return 0.0;
+    std::vector<double> copy = data.toVector();
+    q = std::min(std::max(q, 0.0), 1.0);
+    std::size_t k = static_cast<std::size_t>(q * (copy.size() - 1) + 0.5);
+    std::nth_element(copy.begin(), copy.begin() + k, copy.end());
+    return copy[k];
+  }
+
+  static double calculateQuantile(const std::vector<double> &data, double q) {
+    return calculateQuantile(VectorView(data), q);
+  }
+
+  // Middle value, or the mean of the two middle values for an even count
+  static double calculateMedian(const VectorView &data) {
+    ProfileScope profile(ProfileOp::Quantile, data.size());
+    if (data.empty())
+      return 0.0;
+    std::vector<double> copy = data.toVector();
+    const std::size_t k = copy.size() / 2;
+    std::nth_element(copy.begin(), copy.begin() + k, copy.end());
+    if (copy.size() % 2 == 1)
+      return copy[k];
+    // Everything before k is <= copy[k]; the lower middle is the largest
+    const double lower = *std::max_element(copy.begin(), copy.begin() + k);
+    return (lower + copy[k]) / 2.0;
+  }
+
+  static double calculateMedian(const std::vector<double> &data) {
+    return calculateMedian(VectorView(data));
+  }
 };
 
 #endif
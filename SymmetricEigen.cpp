@@ -0,0 +1,359 @@
+#include "SymmetricEigen.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+// Both phases work on U = V^T, where V accumulates the orthogonal
+// transformations (columns become eigenvectors). A is symmetric, so U
+// starts as A itself, and every inner loop of the reduction and of the QL
+// rotations then runs along a row of U instead of down a column of V.
+// The algorithms are tred2 and tql2 from EISPACK, by way of JAMA.
+
+// Householder reduction to tridiagonal form: diagonal d, subdiagonal
+// e[1..n-1]; U holds the accumulated transformations on return
+static void tridiagonalize(int n, double *u, double *d, double *e) {
+  auto U = [u, n](int r, int c) -> double & {
+    return u[std::size_t(r) * n + c];
+  };
+  for (int j = 0; j < n; j++)
+    d[j] = U(j, n - 1);
+
+  for (int i = n - 1; i > 0; i--) {
+    double scale = 0.0;
+    double h = 0.0;
+    for (int k = 0; k < i; k++)
+      scale += std::abs(d[k]);
+    if (scale == 0.0) {
+      e[i] = d[i - 1];
+      for (int j = 0; j < i; j++) {
+        d[j] = U(j, i - 1);
+        U(j, i) = 0.0;
+        U(i, j) = 0.0;
+      }
+    } else {
+      // Householder vector
+      for (int k = 0; k < i; k++) {
+        d[k] /= scale;
+        h += d[k] * d[k];
+      }
+      double f = d[i - 1];
+      double g = f > 0.0 ? -std::sqrt(h) : std::sqrt(h);
+      e[i] = scale * g;
+      h -= f * g;
+      d[i - 1] = f - g;
+      std::fill(e, e + i, 0.0);
+
+      // Similarity transformation of the remaining rows
+      for (int j = 0; j < i; j++) {
+        const double *uj = &U(j, 0);
+        f = d[j];
+        U(i, j) = f;
+        g = e[j] + uj[j] * f;
+        for (int k = j + 1; k < i; k++) {
+          g += uj[k] * d[k];
+          e[k] += uj[k] * f;
+        }
+        e[j] = g;
+      }
+      f = 0.0;
+      for (int j = 0; j < i; j++) {
+        e[j] /= h;
+        f += e[j] * d[j];
+      }
+      const double hh = f / (h + h);
+      for (int j = 0; j < i; j++)
+        e[j] -= hh * d[j];
+      for (int j = 0; j < i; j++) {
+        double *uj = &U(j, 0);
+        f = d[j];
+        g = e[j];
+        for (int k = j; k < i; k++)
+          uj[k] -= f * e[k] + g * d[k];
+        d[j] = uj[i - 1];
+        uj[i] = 0.0;
+      }
+    }
+    d[i] = h;
+  }
+
+  // Accumulate the transformations
+  for (int i = 0; i < n - 1; i++) {
+    U(i, n - 1) = U(i, i);
+    U(i, i) = 1.0;
+    const double h = d[i + 1];
+    double *next = &U(i + 1, 0);
+    if (h != 0.0) {
+      for (int k = 0; k <= i; k++)
+        d[k] = next[k] / h;
+      for (int j = 0; j <= i; j++) {
+        double *uj = &U(j, 0);
+        double g = 0.0;
+        for (int k = 0; k <= i; k++)
+          g += next[k] * uj[k];
+        for (int k = 0; k <= i; k++)
+          uj[k] -= g * d[k];
+      }
+    }
+    std::fill(next, next + i + 1, 0.0);
+  }
+  for (int j = 0; j < n; j++) {
+    d[j] = U(j, n - 1);
+    U(j, n - 1) = 0.0;
+  }
+  U(n - 1, n - 1) = 1.0;
+  e[0] = 0.0;
+}
+
+// Implicit QL iterations on the tridiagonal matrix. The rotations of one
+// sweep are computed first, then applied to U in parallel column strips.
+static void diagonalize(int n, double *u, double *d, double *e) {
+  for (int i = 1; i < n; i++)
+    e[i - 1] = e[i];
+  e[n - 1] = 0.0;
+  std::vector<double> cosines(n), sines(n);
+  double f = 0.0;
+  double tst1 = 0.0;
+  const double eps = std::ldexp(1.0, -52);
+  for (int l = 0; l < n; l++) {
+    tst1 = std::max(tst1, std::abs(d[l]) + std::abs(e[l]));
+    int m = l;
+    while (std::abs(e[m]) > eps * tst1) // e[n - 1] is zero
+      m++;
+    int iterations = 0;
+    while (m > l && std::abs(e[l]) > eps * tst1) {
+      if (++iterations > 60)
+        throw std::runtime_error("Eigenvalue iteration did not converge");
+      // Implicit shift
+      double g = d[l];
+      double p = (d[l + 1] - g) / (2.0 * e[l]);
+      double r = std::hypot(p, 1.0);
+      if (p < 0)
+        r = -r;
+      d[l] = e[l] / (p + r);
+      d[l + 1] = e[l] * (p + r);
+      const double dl1 = d[l + 1];
+      double h = g - d[l];
+      for (int i = l + 2; i < n; i++)
+        d[i] -= h;
+      f += h;
+
+      // QL sweep
+      p = d[m];
+      double c = 1.0, c2 = 1.0, c3 = 1.0;
+      const double el1 = e[l + 1];
+      double s = 0.0, s2 = 0.0;
+      for (int i = m - 1; i >= l; i--) {
+        c3 = c2;
+        c2 = c;
+        s2 = s;
+        g = c * e[i];
+        h = c * p;
+        r = std::hypot(p, e[i]);
+        e[i + 1] = s * r;
+        s = e[i] / r;
+        c = p / r;
+        p = c * d[i] - s * g;
+        d[i + 1] = h + s * (c * g + s * d[i]);
+        cosines[i] = c;
+        sines[i] = s;
+      }
+      p = -s * s2 * c3 * el1 * e[l] / dl1;
+      e[l] = s * p;
+      d[l] = c * p;
+
+      parallelRange(n, 6LL * (m - l), [&](int first, int last) {
+        for (int i = m - 1; i >= l; i--) {
+          double *a = u + std::size_t(i) * n;
+          double *b = a + n;
+          const double ci = cosines[i];
+          const double si = sines[i];
+          for (int k = first; k < last; k++) {
+            const double t = b[k];
+            b[k] = si * a[k] + ci * t;
+            a[k] = ci * a[k] - si * t;
+          }
+        }
+      });
+    }
+    d[l] += f;
+    e[l] = 0.0;
+  }
+}
+
+SymmetricEigen::SymmetricEigen(const Matrix &A) {
+  if (!A.isSquare())
+    throw std::invalid_argument("Eigenvalues require a square matrix");
+  if (!A.isSymmetric())
+    throw std::invalid_argument("Eigenvalues require a symmetric matrix");
+  const int n = A.getRows();
+  Matrix U(A.view());
+  double *u = U.rowPtr(0);
+  std::vector<double> d(n), e(n);
+  tridiagonalize(n, u, d.data(), e.data());
+  diagonalize(n, u, d.data(), e.data());
+
+  std::vector<int> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&](int a, int b) { return d[a] > d[b]; });
+  values.resize(n);
+  vectors = Matrix(n, n);
+  for (int j = 0; j < n; j++) {
+    values[j] = d[order[j]];
+    const double *src = u + std::size_t(order[j]) * n;
+    for (int i = 0; i < n; i++)
+      vectors.rowPtr(i)[j] = src[i];
+  }
+}
+
+// Lanczos
+
+const int LANCZOS_MAX_RESTARTS = 500;
+
+// Removes from w its components along the first `count` rows of q (two
+// passes of classical Gram-Schmidt, which leaves w orthogonal to working
+// precision) and adds the coefficients to h
+static void orthogonalize(const double *q, std::size_t ld, int count, int n,
+                          double *w, double *h) {
+  for (int pass = 0; pass < 2; pass++) {
+    for (int i = 0; i < count; i++) {
+      const double *qi = q + i * ld;
+      double dot = 0.0;
+      for (int k = 0; k < n; k++)
+        dot += qi[k] * w[k];
+      for (int k = 0; k < n; k++)
+        w[k] -= dot * qi[k];
+      h[i] += dot;
+    }
+  }
+}
+
+static double norm(const double *w, int n) {
+  double sum = 0.0;
+  for (int k = 0; k < n; k++)
+    sum += w[k] * w[k];
+  return std::sqrt(sum);
+}
+
+SymmetricEigen SymmetricEigen::largest(const MatrixView &A, int k,
+                                       double tolerance) {
+  if (A.getRows() != A.getCols())
+    throw std::invalid_argument("Eigenvalues require a square matrix");
+  const int n = A.getRows();
+  return largest(
+      n,
+      [&A, n](const double *x, double *y) {
+        parallelRange(n, n, [&](int first, int last) {
+          for (int i = first; i < last; i++) {
+            const double *row = A.rowPtr(i);
+            double sum = 0.0;
+            for (int j = 0; j < n; j++)
+              sum += row[j] * x[j];
+            y[i] = sum;
+          }
+        });
+      },
+      k, tolerance);
+}
+
+// Thick-restart Lanczos with full reorthogonalization. The basis grows to
+// m vectors; the projected matrix T = Q^T A Q is then diagonalized, and
+// the Ritz vectors of the `keep` largest Ritz values become the start of
+// the next basis, coupled to the residual direction through one arrowhead
+// row of T.
+SymmetricEigen SymmetricEigen::largest(int n, const Product &multiply, int k,
+                                       double tolerance) {
+  if (n < 1 || k < 1 || k > n)
+    throw std::invalid_argument("Invalid number of eigenpairs");
+  const int m = std::min(n, std::max(2 * k + 20, 3 * k));
+  const int keep = std::min(m - 1, k + (m - k) / 2);
+
+  Matrix basis(m, n); // orthonormal rows
+  double *q = basis.rowPtr(0);
+  const std::size_t ld = basis.getStride();
+  Matrix T(m, m);
+  std::vector<double> w(n), h(m);
+  std::mt19937 gen(20240901);
+  std::normal_distribution<double> dist(0.0, 1.0);
+
+  // Unit vector orthogonal to the first `count` rows, written to row count
+  auto randomDirection = [&](int count) {
+    for (double &x : w)
+      x = dist(gen);
+    std::fill(h.begin(), h.end(), 0.0);
+    orthogonalize(q, ld, count, n, w.data(), h.data());
+    const double len = norm(w.data(), n);
+    for (int i = 0; i < n; i++)
+      q[count * ld + i] = w[i] / len;
+  };
+
+  randomDirection(0);
+  int size = 1;
+  double scale = 0.0; // running estimate of ||A||
+  for (int restart = 0; restart < LANCZOS_MAX_RESTARTS; restart++) {
+    // Extend the basis; w ends as the residual of the last vector
+    double residual = 0.0;
+    while (true) {
+      const int j = size - 1;
+      multiply(q + j * ld, w.data());
+      std::fill(h.begin(), h.end(), 0.0);
+      orthogonalize(q, ld, size, n, w.data(), h.data());
+      for (int i = 0; i <= j; i++) {
+        T.rowPtr(i)[j] = h[i];
+        T.rowPtr(j)[i] = h[i];
+      }
+      const double beta = norm(w.data(), n);
+      scale = std::max(scale, std::abs(h[j]) + beta);
+      if (size == m) {
+        residual = beta;
+        break;
+      }
+      if (beta > 1e-13 * scale) {
+        for (int i = 0; i < n; i++)
+          q[size * ld + i] = w[i] / beta;
+      } else {
+        randomDirection(size); // invariant subspace found; start a new one
+      }
+      size++;
+    }
+
+    // Rayleigh-Ritz on the projected matrix
+    SymmetricEigen ritz(Matrix(T.blockView(0, 0, size, size)));
+    const Matrix &S = ritz.vectors;
+    const double *lastRow = S.rowPtr(size - 1);
+    const double bound =
+        tolerance * std::max(std::abs(ritz.values[0]),
+                             std::abs(ritz.values[size - 1]));
+    bool converged = true;
+    for (int i = 0; i < k; i++)
+      converged = converged && residual * std::abs(lastRow[i]) <= bound;
+    if (converged || size == n) {
+      SymmetricEigen result;
+      result.values.assign(ritz.values.begin(), ritz.values.begin() + k);
+      Matrix x = Matrix::multiply(
+          Matrix(S.blockView(0, 0, size, k)).transpose().view(),
+          basis.blockView(0, 0, size, n));
+      result.vectors = std::move(x).transpose();
+      return result;
+    }
+
+    // Thick restart: keep the leading Ritz vectors and the residual
+    Matrix kept = Matrix::multiply(
+        Matrix(S.blockView(0, 0, size, keep)).transpose().view(),
+        basis.blockView(0, 0, size, n));
+    T = Matrix(m, m);
+    for (int i = 0; i < keep; i++) {
+      std::copy(kept.rowPtr(i), kept.rowPtr(i) + n, q + i * ld);
+      T.rowPtr(i)[i] = ritz.values[i];
+      T.rowPtr(i)[keep] = residual * lastRow[i];
+      T.rowPtr(keep)[i] = residual * lastRow[i];
+    }
+    for (int i = 0; i < n; i++)
+      q[keep * ld + i] = w[i] / residual;
+    size = keep + 1;
+  }
+  throw std::runtime_error("Lanczos iteration did not converge");
+}
@@ -0,0 +1,45 @@
+#ifndef SYMMETRIC_EIGEN_H
+#define SYMMETRIC_EIGEN_H
+
+#include "Matrix.h"
+#include <functional>
+#include <vector>
+
+// Eigen-decomposition of a real symmetric matrix: A * v = lambda * v.
+// Eigenvalues are sorted in descending order, and column j of
+// getVectors() is the unit eigenvector of getValues()[j].
+//
+// The constructor computes the full spectrum: Householder reduction to
+// tridiagonal form, then implicit QL iterations (O(n^3), for moderate n).
+// largest() computes only the k largest eigenpairs with thick-restart
+// Lanczos. It touches A only through matrix-vector products, so when
+// k << n it costs a few dozen products instead of O(n^3).
+class SymmetricEigen {
+public:
+  // y = A * x, with x and y of length n
+  typedef std::function<void(const double *x, double *y)> Product;
+
+private:
+  std::vector<double> values;
+  Matrix vectors; // n x values.size()
+
+  SymmetricEigen() = default;
+
+public:
+  // Throws std::invalid_argument unless A is square and symmetric
+  explicit SymmetricEigen(const Matrix &A);
+
+  // The k largest eigenpairs, each with residual ||A v - lambda v|| at most
+  // tolerance * |largest eigenvalue|. A must be symmetric (not checked).
+  static SymmetricEigen largest(const MatrixView &A, int k,
+                                double tolerance = 1e-10);
+  // Same for an operator given only by its product, e.g. a SparseMatrix
+  static SymmetricEigen largest(int n, const Product &multiply, int k,
+                                double tolerance = 1e-10);
+
+  int size() const { return static_cast<int>(values.size()); }
+  const std::vector<double> &getValues() const { return values; }
+  const Matrix &getVectors() const { return vectors; }
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+
+static thread_local bool insideParallelLoop = false;
+
+// Marks the current thread as running loop bodies for its lifetime
+struct ParallelRegionGuard {
+  ParallelRegionGuard() { insideParallelLoop = true; }
+  ~ParallelRegionGuard() { insideParallelLoop = false; }
+};
+
+static int defaultThreadCount() {
+  if (const char *env = std::getenv("MATRIX_NUM_THREADS")) {
+    int count = std::atoi(env);
+    if (count > 0)
+      return count;
+  }
+  unsigned hw = std::thread::hardware_concurrency();
+  return hw > 0 ? static_cast<int>(hw) : 1;
+}
+
+ThreadPool::ThreadPool()
+    : threadCount(1), generation(0), stopping(false), pendingWorkers(0),
+      body(nullptr), jobEnd(0), jobChunk(1), nextIndex(0) {
+  startWorkers(defaultThreadCount() - 1);
+}
+
+ThreadPool::~ThreadPool() { stopWorkers(); }
+
+ThreadPool &ThreadPool::instance() {
+  static ThreadPool pool;
+  return pool;
+}
+
+bool ThreadPool::inParallelRegion() { return insideParallelLoop; }
+
+// New workers start from the current generation, so a pool resized after
+// it has run does not wake them for a loop that is already over
+void ThreadPool::startWorkers(int count) {
+  std::lock_guard<std::mutex> lock(mutex);
+  stopping = false;
+  for (int i = 0; i < count; i++)
+    workers.emplace_back(&ThreadPool::workerLoop, this, generation);
+  threadCount.store(static_cast<int>(workers.size()) + 1);
+}
+
+void ThreadPool::stopWorkers() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread &t : workers)
+    t.join();
+  workers.clear();
+  threadCount.store(1);
+}
+
+void ThreadPool::setThreadCount(int count) {
+  if (count < 1)
+    throw std::invalid_argument("Thread count must be at least 1");
+  if (insideParallelLoop)
+    throw std::logic_error(
+        "Cannot resize the thread pool from a parallel loop");
+  std::lock_guard<std::mutex> submit(submitMutex);
+  stopWorkers();
+  startWorkers(count - 1);
+}
+
+void ThreadPool::runChunks() {
+  while (true) {
+    const int first = nextIndex.fetch_add(jobChunk);
+    if (first >= jobEnd)
+      break;
+    const int last = std::min(first + jobChunk, jobEnd);
+    try {
+      (*body)(first, last);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!error)
+        error = std::current_exception();
+    }
+  }
+}
+
+void ThreadPool::workerLoop(unsigned long seen) {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [&] { return stopping || generation != seen; });
+      if (stopping)
+        return;
+      seen = generation;
+    }
+    {
+      ParallelRegionGuard guard;
+      runChunks();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (--pendingWorkers == 0)
+      finished.notify_one();
+  }
+}
+
+void ThreadPool::parallelFor(int begin, int end, int minChunk,
+                             const std::function<void(int, int)> &fn) {
+  if (begin >= end)
+    return;
+  minChunk = std::max(minChunk, 1);
+  const int range = end - begin;
+  if (getThreadCount() == 1 || range <= minChunk || insideParallelLoop) {
+    fn(begin, end);
+    return;
+  }
+  std::unique_lock<std::mutex> submit(submitMutex, std::try_to_lock);
+  if (!submit.owns_lock()) {
+    // Another thread is already using every core
+    fn(begin, end);
+    return;
+  }
+
+  // The worker list is stable while submitMutex is held. A few chunks per
+  // thread keeps the load balanced without much overhead.
+  const int threads = static_cast<int>(workers.size()) + 1;
+  const int chunk =
+      std::max(minChunk, (range + 4 * threads - 1) / (4 * threads));
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    body = &fn;
+    jobEnd = end;
+    jobChunk = chunk;
+    nextIndex.store(begin);
+    error = nullptr;
+    pendingWorkers = static_cast<int>(workers.size());
+    generation++;
+  }
+  wake.notify_all();
+  {
+    ParallelRegionGuard guard;
+    runChunks();
+  }
+  std::exception_ptr failure;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&] { return pendingWorkers == 0; });
+    body = nullptr;
+    failure = error;
+    error = nullptr;
+  }
+  if (failure)
+    std::rethrow_exception(failure);
+}
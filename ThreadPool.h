@@ -0,0 +1,86 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Process-wide pool of worker threads shared by all Matrix operations.
+//
+// The calling thread always takes part in the work, so a pool of N threads
+// runs N - 1 workers. Only one parallel loop runs at a time: a loop started
+// from inside another one (or while another thread owns the pool) runs
+// serially on the calling thread instead of oversubscribing the cores.
+class ThreadPool {
+private:
+  std::vector<std::thread> workers; // replaced only under submitMutex
+  std::atomic<int> threadCount;      // workers.size() + 1, readable anywhere
+
+  std::mutex submitMutex; // held by the thread that owns the current loop
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable finished;
+  unsigned long generation;
+  bool stopping;
+  int pendingWorkers;
+
+  // Current loop
+  const std::function<void(int, int)> *body;
+  int jobEnd;
+  int jobChunk;
+  std::atomic<int> nextIndex;
+  std::exception_ptr error;
+
+  ThreadPool();
+  ~ThreadPool();
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  void startWorkers(int count);
+  void stopWorkers();
+  void workerLoop(unsigned long seen);
+  void runChunks();
+
+public:
+  static ThreadPool &instance();
+
+  // Total number of threads used by a parallel loop (workers + caller).
+  // Defaults to MATRIX_NUM_THREADS or the number of hardware threads.
+  void setThreadCount(int count);
+  int getThreadCount() const {
+    return threadCount.load(std::memory_order_relaxed);
+  }
+
+  // Calls body(first, last) over disjoint sub-ranges covering
+  // [begin, end). Ranges no longer than minChunk are not split.
+  void parallelFor(int begin, int end, int minChunk,
+                   const std::function<void(int, int)> &body);
+
+  // True on a thread that is currently executing a parallel loop body
+  static bool inParallelRegion();
+};
+
+// Minimum amount of work (roughly, element updates) worth a parallel loop
+const long long PARALLEL_MIN_WORK = 1 << 15;
+
+// Calls body(first, last) over [0, count). Goes through the shared pool
+// only when count * costPerItem is large enough to pay for the hand-off;
+// small ranges run inline without touching the pool. The body is passed by
+// reference, so wrapping it in a std::function never allocates.
+template <typename F>
+void parallelRange(int count, long long costPerItem, F &&body) {
+  costPerItem = costPerItem > 0 ? costPerItem : 1;
+  if (count * costPerItem < 2 * PARALLEL_MIN_WORK) {
+    body(0, count);
+    return;
+  }
+  long long minChunk = PARALLEL_MIN_WORK / costPerItem;
+  ThreadPool::instance().parallelFor(
+      0, count, minChunk > 0 ? static_cast<int>(minChunk) : 1, std::ref(body));
+}
+
+#endif
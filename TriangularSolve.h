@@ -0,0 +1,112 @@
+#ifndef TRIANGULAR_SOLVE_H
+#define TRIANGULAR_SOLVE_H
+
+#include "Gemm.h"
+#include "MatrixArena.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+// Blocked forward and back substitution shared by LUDecomposition (double)
+// and FloatLUDecomposition (float). Internal to the LU classes.
+
+// Rows per block in the triangular solves. Blocks below/above the
+// diagonal block are applied with gemm; only the diagonal blocks are
+// solved row by row.
+const int SOLVE_BLOCK = 64;
+
+// Columns of X per task in the diagonal-block solves
+const int SOLVE_COLUMNS = 256;
+
+// x(row0 .. row0 + rows) -= A * B, where A is rows x inner and B holds the
+// first `inner` rows of the solution block
+template <typename T>
+void subtractProduct(int rows, int m, int inner, const T *A, int lda,
+                     const T *B, int ldb, T *x, int ldx) {
+  std::pmr::vector<T> product(static_cast<std::size_t>(rows) * m, T(0),
+                              MatrixResourceScope::current());
+  gemm(rows, m, inner, A, lda, B, ldb, product.data(), m);
+  for (int i = 0; i < rows; i++) {
+    const T *p = product.data() + static_cast<std::size_t>(i) * m;
+    T *xi = x + static_cast<std::size_t>(i) * ldx;
+    for (int j = 0; j < m; j++)
+      xi[j] -= p[j];
+  }
+}
+
+// Solves L * U * X = X in place for the n x n packed factors `lu` (L unit
+// lower, U upper) and the n x m right-hand sides X, already permuted.
+// Off-diagonal blocks go through gemm; inside a diagonal block every
+// update is a contiguous axpy along a row strip of X.
+template <typename T>
+void luSolveInPlace(int n, const T *lu, int ldlu, T *x, int m, int ldx) {
+  auto luRow = [&](int i) { return lu + static_cast<std::size_t>(i) * ldlu; };
+  auto xRow = [&](int i) { return x + static_cast<std::size_t>(i) * ldx; };
+
+  // Diagonal block [i0, i1) of L (unit) or U, on columns [c0, c1) of X
+  auto lowerBlock = [&](int i0, int i1, int c0, int c1) {
+    for (int i = i0 + 1; i < i1; i++) {
+      const T *l = luRow(i);
+      T *xi = xRow(i);
+      for (int k = i0; k < i; k++) {
+        const T factor = l[k];
+        if (factor == T(0))
+          continue;
+        const T *xk = xRow(k);
+        for (int j = c0; j < c1; j++)
+          xi[j] -= factor * xk[j];
+      }
+    }
+  };
+  auto upperBlock = [&](int i0, int i1, int c0, int c1) {
+    for (int i = i1 - 1; i >= i0; i--) {
+      const T *u = luRow(i);
+      T *xi = xRow(i);
+      for (int k = i + 1; k < i1; k++) {
+        const T factor = u[k];
+        if (factor == T(0))
+          continue;
+        const T *xk = xRow(k);
+        for (int j = c0; j < c1; j++)
+          xi[j] -= factor * xk[j];
+      }
+      const T invPivot = T(1) / u[i];
+      for (int j = c0; j < c1; j++)
+        xi[j] *= invPivot;
+    }
+  };
+  // Column strips are independent, so the diagonal solves run in parallel
+  const int strips = (m + SOLVE_COLUMNS - 1) / SOLVE_COLUMNS;
+  auto overStrips = [&](int i0, int i1, bool lower) {
+    const long long width = std::min(m, SOLVE_COLUMNS);
+    const long long cost = static_cast<long long>(i1 - i0) * (i1 - i0) * width;
+    parallelRange(strips, cost, [&](int first, int last) {
+      for (int s = first; s < last; s++) {
+        const int c0 = s * SOLVE_COLUMNS;
+        const int c1 = std::min(m, c0 + SOLVE_COLUMNS);
+        if (lower)
+          lowerBlock(i0, i1, c0, c1);
+        else
+          upperBlock(i0, i1, c0, c1);
+      }
+    });
+  };
+
+  for (int i0 = 0; i0 < n; i0 += SOLVE_BLOCK) {
+    const int i1 = std::min(n, i0 + SOLVE_BLOCK);
+    if (i0 > 0)
+      subtractProduct(i1 - i0, m, i0, luRow(i0), ldlu, x, ldx, xRow(i0), ldx);
+    overStrips(i0, i1, true);
+  }
+  for (int i1 = n; i1 > 0; i1 -= SOLVE_BLOCK) {
+    const int i0 = std::max(0, i1 - SOLVE_BLOCK);
+    if (i1 < n)
+      subtractProduct(i1 - i0, m, n - i1, luRow(i0) + i1, ldlu, xRow(i1), ldx,
+                      xRow(i0), ldx);
+    overStrips(i0, i1, false);
+  }
+}
+
+#endif
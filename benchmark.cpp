@@ -0,0 +1,838 @@
+// Performance benchmarks for the Matrix library.
+//
+// Build: make benchmark (the binary is build/benchmark)
+// Run:   ./benchmark [gemm|batch|quantile|sparse]
+//        ./benchmark pool [resizes]
+//        ./benchmark suite [--format table|csv|json] [--sizes 16,64,256]
+//                          [--lengths 1000,100000,1000000] [--min-time 0.2]
+//                          [--warmup 2] [--filter name]
+
+#include "FloatMatrix.h"
+#include "Gemm.h"
+#include "IncrementalInverse.h"
+#include "Matrix.h"
+#include "MatrixBatch.h"
+#include "MatrixChain.h"
+#include "SparseMatrix.h"
+#include "Statistics.h"
+#include "SymmetricEigen.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+// Allocation counting. Replacing the global operator new counts every heap
+// allocation in the process, including those made on pool threads and the
+// aligned ones behind std::pmr storage.
+static atomic<long long> allocationCount(0);
+static atomic<long long> allocatedBytes(0);
+
+static void *countedAlloc(size_t size) {
+  allocationCount.fetch_add(1, memory_order_relaxed);
+  allocatedBytes.fetch_add(static_cast<long long>(size), memory_order_relaxed);
+  void *p = malloc(size > 0 ? size : 1);
+  if (p == nullptr)
+    throw bad_alloc();
+  return p;
+}
+
+// Over-allocates and keeps the malloc pointer just below the aligned block
+static void *countedAlignedAlloc(size_t size, align_val_t alignment) {
+  const size_t align = static_cast<size_t>(alignment);
+  char *raw = static_cast<char *>(countedAlloc(size + align + sizeof(void *)));
+  const uintptr_t first = reinterpret_cast<uintptr_t>(raw) + sizeof(void *);
+  char *aligned = raw + ((first + align - 1) / align * align -
+                         reinterpret_cast<uintptr_t>(raw));
+  reinterpret_cast<void **>(aligned)[-1] = raw;
+  return aligned;
+}
+
+static void alignedFree(void *p) {
+  if (p != nullptr)
+    free(reinterpret_cast<void **>(p)[-1]);
+}
+
+void *operator new(size_t size) { return countedAlloc(size); }
+void *operator new[](size_t size) { return countedAlloc(size); }
+void *operator new(size_t size, align_val_t a) {
+  return countedAlignedAlloc(size, a);
+}
+void *operator new[](size_t size, align_val_t a) {
+  return countedAlignedAlloc(size, a);
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+void operator delete(void *p, align_val_t) noexcept { alignedFree(p); }
+void operator delete[](void *p, align_val_t) noexcept { alignedFree(p); }
+void operator delete(void *p, size_t, align_val_t) noexcept {
+  alignedFree(p);
+}
+void operator delete[](void *p, size_t, align_val_t) noexcept {
+  alignedFree(p);
+}
+
+Matrix randomMatrix(int rows, int cols, unsigned seed) {
+  mt19937 gen(seed);
+  uniform_real_distribution<double> dist(-1.0, 1.0);
+  Matrix m(rows, cols);
+  for (int i = 0; i < rows; i++)
+    for (int j = 0; j < cols; j++)
+      m.rowPtr(i)[j] = dist(gen);
+  return m;
+}
+
+// Seconds per call, repeating until at least minSeconds have elapsed
+template <typename F> double timeIt(F &&fn, double minSeconds = 0.2) {
+  fn(); // warmup
+  int reps = 0;
+  Clock::time_point start = Clock::now();
+  double elapsed = 0.0;
+  do {
+    fn();
+    reps++;
+    elapsed = chrono::duration<double>(Clock::now() - start).count();
+  } while (elapsed < minSeconds);
+  return elapsed / reps;
+}
+
+// The original i-j-k loop that Matrix::operator* used before the GEMM kernel
+Matrix naiveMultiply(const Matrix &a, const Matrix &b) {
+  Matrix result(a.getRows(), b.getCols());
+  for (int i = 0; i < a.getRows(); i++) {
+    for (int j = 0; j < b.getCols(); j++) {
+      double sum = 0.0;
+      for (int k = 0; k < a.getCols(); k++)
+        sum += a.rowPtr(i)[k] * b.rowPtr(k)[j];
+      result.rowPtr(i)[j] = sum;
+    }
+  }
+  return result;
+}
+
+double maxAbsDiff(const Matrix &a, const Matrix &b) {
+  double diff = 0.0;
+  for (int i = 0; i < a.getRows(); i++)
+    for (int j = 0; j < a.getCols(); j++)
+      diff = max(diff, abs(a.rowPtr(i)[j] - b.rowPtr(i)[j]));
+  return diff;
+}
+
+void benchGemm() {
+  cout << "GEMM kernel: " << gemmKernelName() << "\n";
+  cout << "     n   naive GFLOP/s    gemm GFLOP/s   speedup   max |diff|\n";
+  const int sizes[] = {32, 64, 128, 256, 512, 1024};
+  for (int n : sizes) {
+    Matrix a = randomMatrix(n, n, 1);
+    Matrix b = randomMatrix(n, n, 2);
+    const double flops = 2.0 * n * n * n;
+    Matrix c1, c2;
+    double tNaive = timeIt([&] { c1 = naiveMultiply(a, b); });
+    double tGemm = timeIt([&] { c2 = a * b; });
+    cout << setw(6) << n << setw(16) << fixed << setprecision(2)
+         << flops / tNaive * 1e-9 << setw(16) << flops / tGemm * 1e-9
+         << setw(9) << setprecision(1) << tNaive / tGemm << "x"
+         << setw(13) << scientific << setprecision(1) << maxAbsDiff(c1, c2)
+         << "\n";
+  }
+}
+
+// Determinant + inverse of many small matrices: one Matrix at a time versus
+// a single MatrixBatch
+void benchBatch() {
+  const int count = 100000;
+  cout << "Batch of " << count << " matrices (time per matrix, ns)\n";
+  cout << "     n   Matrix det+inv   MatrixBatch det+inv   speedup\n";
+  for (int n = 2; n <= 5; n++) {
+    MatrixBatch batch(count, n, n);
+    vector<Matrix> singles;
+    for (int b = 0; b < count; b++) {
+      Matrix m = randomMatrix(n, n, b);
+      batch.setMatrix(b, m);
+      singles.push_back(m);
+    }
+    double sink = 0.0;
+    double tSingle = timeIt([&] {
+      for (const Matrix &m : singles)
+        sink += m.determinant() + m.inverse().get(0, 0);
+    });
+    double tBatch = timeIt([&] {
+      sink += batch.determinant()[0] + batch.inverse().get(0, 0, 0);
+    });
+    cout << setw(6) << n << setw(17) << fixed << setprecision(1)
+         << tSingle / count * 1e9 << setw(22) << tBatch / count * 1e9
+         << setw(9) << tSingle / tBatch << "x" << (sink == 0.123 ? " " : "")
+         << "\n";
+  }
+}
+
+// QuantileSketch against exact selection (nth_element) on the same data
+void benchQuantile() {
+  const size_t count = 10000000;
+  mt19937_64 gen(7);
+  lognormal_distribution<double> dist(0.0, 1.0); // latency-like long tail
+  vector<double> values(count);
+  for (double &v : values)
+    v = dist(gen);
+  const double qs[] = {0.5, 0.9, 0.99, 0.999};
+
+  Clock::time_point start = Clock::now();
+  QuantileSketch sketch;
+  sketch.add(values);
+  double estimates[4];
+  for (int i = 0; i < 4; i++)
+    estimates[i] = sketch.quantile(qs[i]);
+  double tSketch = chrono::duration<double>(Clock::now() - start).count();
+
+  start = Clock::now();
+  double exact[4];
+  for (int i = 0; i < 4; i++)
+    exact[i] = Statistics::calculateQuantile(values, qs[i]);
+  double tExact = chrono::duration<double>(Clock::now() - start).count();
+
+  vector<double> sorted(values);
+  sort(sorted.begin(), sorted.end());
+  cout << count << " lognormal samples, " << sketch.centroidCount()
+       << " centroids\n";
+  cout << "  sketch (add all + 4 queries): " << fixed << setprecision(3)
+       << tSketch << " s, exact nth_element x4: " << tExact << " s\n";
+  cout << "     q        exact     estimate   rel. error   rank error\n";
+  for (int i = 0; i < 4; i++) {
+    double rank =
+        double(lower_bound(sorted.begin(), sorted.end(), estimates[i]) -
+               sorted.begin()) /
+        count;
+    cout << setw(6) << setprecision(3) << qs[i] << setw(13)
+         << setprecision(5) << exact[i] << setw(13) << estimates[i]
+         << setw(13) << scientific << setprecision(2)
+         << abs(estimates[i] - exact[i]) / exact[i] << setw(13)
+         << abs(rank - qs[i]) << fixed << "\n";
+  }
+}
+
+// Random sparse matrix with small integer entries, so that ranks are exact.
+// The last `dependent` rows are sums of two earlier rows, which makes the
+// matrix rank deficient.
+Matrix randomSparse(int n, double density, int dependent, unsigned seed) {
+  mt19937 gen(seed);
+  uniform_real_distribution<double> chance(0.0, 1.0);
+  uniform_int_distribution<int> value(1, 4);
+  uniform_int_distribution<int> pick(0, n - dependent - 1);
+  Matrix m(n, n);
+  for (int i = 0; i < n - dependent; i++)
+    for (int j = 0; j < n; j++)
+      if (chance(gen) < density)
+        m.rowPtr(i)[j] = chance(gen) < 0.5 ? -value(gen) : value(gen);
+  for (int i = n - dependent; i < n; i++) {
+    const double *a = m.rowPtr(pick(gen));
+    const double *b = m.rowPtr(pick(gen));
+    for (int j = 0; j < n; j++)
+      m.rowPtr(i)[j] = a[j] + 2.0 * b[j];
+  }
+  return m;
+}
+
+// SparseMatrix::rank/rref against Matrix::rank/rref on the same inputs.
+// The rref difference is relative to the largest rref entry. The two
+// eliminations pick different pivots, so on ill-conditioned inputs their
+// rounding differs, and with it which entries fall below EPSILON.
+void benchSparse() {
+  cout << "     n  density  dependent     nnz   rank (dense/sparse)"
+          "   rref rel. diff   dense ms   sparse ms\n";
+  const int sizes[] = {100, 400, 1000};
+  const double densities[] = {0.01, 0.05};
+  int cases = 0;
+  int agreeing = 0;
+  unsigned seed = 1;
+  for (int n : sizes) {
+    for (double density : densities) {
+      for (int dependent : {0, n / 10}) {
+        const Matrix dense = randomSparse(n, density, dependent, seed++);
+        const SparseMatrix sparse = SparseMatrix::fromDense(dense);
+        const int denseRank = dense.rank();
+        const int sparseRank = sparse.rank();
+        const Matrix denseRref = dense.rref();
+        double largest = 1.0;
+        for (int i = 0; i < n; i++)
+          for (int j = 0; j < n; j++)
+            largest = max(largest, abs(denseRref.rowPtr(i)[j]));
+        const double diff =
+            maxAbsDiff(denseRref, sparse.rref().toDense()) / largest;
+        double sink = 0.0;
+        double tDense = timeIt([&] {
+          Matrix copy = dense;
+          copy.set(0, 0, copy.get(0, 0)); // drops the shared cached rref
+          sink += copy.rref().get(0, 0);
+        });
+        double tSparse = timeIt([&] { sink += sparse.rref().nonZeros(); });
+        cases++;
+        if (denseRank == sparseRank)
+          agreeing++;
+        cout << setw(6) << n << setw(9) << fixed << setprecision(2)
+             << density << setw(11) << dependent << setw(8)
+             << sparse.nonZeros() << setw(11) << denseRank << " / "
+             << setw(5) << sparseRank << setw(17) << scientific
+             << setprecision(1) << diff << fixed << setprecision(3)
+             << setw(11) << tDense * 1e3 << setw(12) << tSparse * 1e3
+             << (sink == 0.123 ? " " : "") << "\n";
+      }
+    }
+  }
+  cout << "ranks agree on " << agreeing << " of " << cases << " inputs\n";
+}
+
+// Resizes the shared pool while another thread keeps it busy with
+// parallel loops. Every loop must cover its range exactly once, and no
+// body may still be running when parallelFor returns. Returns false on
+// the first violation.
+bool stressPool(int resizes) {
+  ThreadPool &pool = ThreadPool::instance();
+  const int original = pool.getThreadCount();
+  atomic<bool> done(false);
+  atomic<int> running(0);
+  atomic<long long> loops(0);
+  string failure;
+  thread submitter([&] {
+    const int count = 4096;
+    while (!done.load() && failure.empty()) {
+      vector<int> hits(count, 0); // on this stack frame, like real callers
+      pool.parallelFor(0, count, 16, [&](int first, int last) {
+        running++;
+        for (int i = first; i < last; i++)
+          hits[i]++;
+        running--;
+      });
+      if (running.load() != 0)
+        failure = "a loop body was still running after parallelFor";
+      for (int i = 0; i < count && failure.empty(); i++)
+        if (hits[i] != 1)
+          failure = "index " + to_string(i) + " ran " +
+                    to_string(hits[i]) + " times";
+      loops++;
+    }
+  });
+  for (int r = 0; r < resizes && failure.empty(); r++) {
+    pool.setThreadCount(2 + r % 3);
+    // Let a few loops through, so workers join a pool that has already run
+    const long long target = loops.load() + 3;
+    while (loops.load() < target && failure.empty())
+      this_thread::yield();
+  }
+  done.store(true);
+  submitter.join();
+  pool.setThreadCount(original);
+  if (!failure.empty()) {
+    cout << "pool stress FAILED: " << failure << "\n";
+    return false;
+  }
+  cout << "pool stress: " << resizes << " resizes during parallel loops, ok\n";
+  return true;
+}
+
+// Suite: every Matrix and Statistics operation over a sweep of sizes, in
+// a machine-readable form so runs can be compared across commits
+
+typedef function<void()> Op;
+
+static volatile double sink;
+static void consume(double v) { sink = sink + v; }
+
+// Drops cached results (rank, rref, LU) so every repetition recomputes
+static void touch(Matrix &m) { m.set(0, 0, m.get(0, 0)); }
+
+// Diagonally dominant, so inverse and solve stay well conditioned
+static Matrix wellConditioned(int n, unsigned seed) {
+  Matrix m = randomMatrix(n, n, seed);
+  for (int i = 0; i < n; i++)
+    m.rowPtr(i)[i] += n;
+  return m;
+}
+
+static vector<double> randomVector(size_t n, unsigned seed) {
+  mt19937 gen(seed);
+  normal_distribution<double> dist(0.0, 1.0);
+  vector<double> v(n);
+  for (double &x : v)
+    x = dist(gen);
+  return v;
+}
+
+struct SuiteCase {
+  const char *group;
+  const char *name;
+  double (*flops)(double n); // per op, 0 when not meaningful
+  Op (*setup)(int n);        // builds the operands, returns one operation
+};
+
+static double noFlops(double) { return 0.0; }
+
+static const SuiteCase SUITE[] = {
+    // Element-wise
+    {"matrix", "add", [](double n) { return n * n; },
+     [](int n) -> Op {
+       Matrix a = randomMatrix(n, n, 1), b = randomMatrix(n, n, 2), c(n, n);
+       return [a, b, c]() mutable { c = a + b; };
+     }},
+    {"matrix", "subtract", [](double n) { return n * n; },
+     [](int n) -> Op {
+       Matrix a = randomMatrix(n, n, 1), b = randomMatrix(n, n, 2), c(n, n);
+       return [a, b, c]() mutable { c = a - b; };
+     }},
+    {"matrix", "scale", [](double n) { return n * n; },
+     [](int n) -> Op {
+       Matrix a = randomMatrix(n, n, 1), c(n, n);
+       return [a, c]() mutable { c = a * 2.0; };
+     }},
+    {"matrix", "add_fused", [](double n) { return 3 * n * n; },
+     [](int n) -> Op {
+       Matrix a = randomMatrix(n, n, 1), b = randomMatrix(n, n, 2);
+       Matrix d = randomMatrix(n, n, 3), c(n, n);
+       return [a, b, d, c]() mutable { c = a + b - d * 0.5; };
+     }},
+    {"matrix", "add_new", [](double n) { return n * n; },
+     [](int n) -> Op {
+       Matrix a = randomMatrix(n, n, 1), b = randomMatrix(n, n, 2);
+       return [a, b] { consume(Matrix(a + b).get(0, 0)); };
+     }},
+    {"matrix", "add_in_place", [](double n) { return n * n; },
+     [](int n) -> Op {
+       Matrix a = randomMatrix(n, n, 1), b = randomMatrix(n, n, 2);
+       return [a, b]() mutable { a += b; };
+     }},
+    // Products and layout
+    {"matrix", "multiply", [](double n) { return 2 * n * n * n; },
+     [](int n) -> Op {
+       Matrix a = randomMatrix(n, n, 1), b = randomMatrix(n, n, 2);
+       return [a, b] { consume((a * b).get(0, 0)); };
+     }},
+    {"matrix", "multiply_float", [](double n) { return 2 * n * n * n; },
+     [](int n) -> Op {
+       FloatMatrix a(randomMatrix(n, n, 1).view());
+       FloatMatrix b(randomMatrix(n, n, 2).view());
+       return [a, b] { consume((a * b).get(0, 0)); };
+     }},
+    {"matrix", "multiply_in_place", [](double n) { return 2 * n * n * n; },
+     [](int n) -> Op {
+       Matrix a = randomMatrix(n, n, 1), b = Matrix::identity(n);
+       return [a, b]() mutable { a *= b; };
+     }},
+    // n x 4 times 4 x n times n x 4: left to right builds an n x n temporary
+    {"matrix", "chain_naive", [](double n) { return 16 * n * n; },
+     [](int n) -> Op {
+       Matrix a = randomMatrix(n, 4, 1), b = randomMatrix(4, n, 2);
+       Matrix c = randomMatrix(n, 4, 3);
+       return [a, b, c] { consume((a * b * c).get(0, 0)); };
+     }},
+    {"matrix", "chain_planned", [](double n) { return 64 * n; },
+     [](int n) -> Op {
+       Matrix a = randomMatrix(n, 4, 1), b = randomMatrix(4, n, 2);
+       Matrix c = randomMatrix(n, 4, 3);
+       return [a, b, c] {
+         consume(MatrixChain{a, b, c}.evaluate().get(0, 0));
+       };
+     }},
+    {"matrix", "transpose", noFlops,
+     [](int n) -> Op {
+       Matrix a = randomMatrix(n, n, 1);
+       return [a] { consume(a.transpose().get(0, 0)); };
+     }},
+    {"matrix", "transpose_in_place", noFlops,
+     [](int n) -> Op {
+       Matrix a = randomMatrix(n, n, 1);
+       return [a]() mutable { a.transposeInPlace(); };
+     }},
+    {"matrix", "trace", [](double n) { return n; },
+     [](int n) -> Op {
+       Matrix a = randomMatrix(n, n, 1);
+       return [a] { consume(a.trace()); };
+     }},
+    {"matrix", "is_symmetric", noFlops,
+     [](int n) -> Op {
+       Matrix a = Matrix::identity(n);
+       return [a] { consume(a.isSymmetric()); };
+     }},
+    {"matrix", "submatrix", noFlops,
+     [](int n) -> Op {
+       Matrix a = randomMatrix(n, n, 1);
+       return [a, n] { consume(a.getSubmatrix(n / 2, n / 2).get(0, 0)); };
+     }},
+    // Factorizations (caches are dropped before every call)
+    {"matrix", "determinant", [](double n) { return 2 * n * n * n / 3; },
+     [](int n) -> Op {
+       Matrix a = randomMatrix(n, n, 1);
+       return [a]() mutable {
+         touch(a);
+         consume(a.determinant());
+       };
+     }},
+    {"matrix", "inverse", [](double n) { return 2 * n * n * n; },
+     [](int n) -> Op {
+       Matrix a = wellConditioned(n, 1);
+       return [a]() mutable {
+         touch(a);
+         consume(a.inverse().get(0, 0));
+       };
+     }},
+    // One entry changed, then the new inverse and determinant
+    {"matrix", "inverse_update", [](double n) { return 2 * n * n; },
+     [](int n) -> Op {
+       IncrementalInverse inc(wellConditioned(n, 1));
+       int k = 0;
+       return [inc, k, n]() mutable {
+         const int i = k % n, j = (k * 7 + 3) % n;
+         inc.set(i, j, inc.getMatrix().get(i, j) + (k % 2 ? -1.0 : 1.0));
+         k++;
+         consume(inc.determinant() + inc.inverse().get(0, 0));
+       };
+     }},
+    {"matrix", "solve", [](double n) { return 8 * n * n * n / 3; },
+     [](int n) -> Op {
+       Matrix a = wellConditioned(n, 1), b = randomMatrix(n, n, 2);
+       return [a, b]() mutable {
+         touch(a);
+         consume(Matrix::solve(a, b).get(0, 0));
+       };
+     }},
+    // One right-hand side, where the O(n^3) factorization dominates
+    {"matrix", "solve_vector", [](double n) { return 2 * n * n * n / 3; },
+     [](int n) -> Op {
+       Matrix a = wellConditioned(n, 1), b = randomMatrix(n, 1, 2);
+       return [a, b]() mutable {
+         touch(a);
+         consume(Matrix::solve(a, b).get(0, 0));
+       };
+     }},
+    {"matrix", "solve_mixed", [](double n) { return 2 * n * n * n / 3; },
+     [](int n) -> Op {
+       Matrix a = wellConditioned(n, 1), b = randomMatrix(n, 1, 2);
+       return [a, b] { consume(solveMixedPrecision(a, b).get(0, 0)); };
+     }},
+    {"matrix", "rref", [](double n) { return n * n * n; },
+     [](int n) -> Op {
+       Matrix a = randomMatrix(n, n, 1);
+       return [a]() mutable {
+         touch(a);
+         consume(a.rref().get(0, 0));
+       };
+     }},
+    {"matrix", "rank", [](double n) { return n * n * n; },
+     [](int n) -> Op {
+       Matrix a = randomMatrix(n, n, 1);
+       return [a]() mutable {
+         touch(a);
+         consume(a.rank());
+       };
+     }},
+    {"matrix", "basis", [](double n) { return n * n * n; },
+     [](int n) -> Op {
+       Matrix a = randomMatrix(n, n, 1);
+       return [a]() mutable {
+         touch(a);
+         consume(a.basis().size());
+       };
+     }},
+    {"matrix", "is_linearly_independent", [](double n) { return n * n * n; },
+     [](int n) -> Op {
+       Matrix a = randomMatrix(n, n, 1);
+       return [a]() mutable {
+         touch(a);
+         consume(a.isLinearlyIndependent());
+       };
+     }},
+    {"matrix", "gram_schmidt", [](double n) { return 8 * n * n * n / 3; },
+     [](int n) -> Op {
+       Matrix a = randomMatrix(n, n, 1);
+       return [a] { consume(a.gramSchmidt().get(0, 0)); };
+     }},
+    {"matrix", "eigen_full", [](double n) { return 9 * n * n * n; },
+     [](int n) -> Op {
+       Matrix a = randomMatrix(n, n, 1);
+       a = a + a.transpose();
+       return [a] { consume(SymmetricEigen(a).getValues()[0]); };
+     }},
+    {"matrix", "eigen_top4", noFlops,
+     [](int n) -> Op {
+       Matrix a = randomMatrix(n, n, 1);
+       a = a + a.transpose();
+       const int k = min(n, 4);
+       return [a, k] {
+         consume(SymmetricEigen::largest(a, k).getValues()[0]);
+       };
+     }},
+    {"matrix", "rank_cached", noFlops,
+     [](int n) -> Op {
+       Matrix a = randomMatrix(n, n, 1);
+       return [a] { consume(a.rank()); };
+     }},
+
+    // Statistics; the size is the number of samples
+    {"statistics", "mean", [](double n) { return n; },
+     [](int n) -> Op {
+       vector<double> v = randomVector(n, 1);
+       return [v] { consume(Statistics::calculateMean(v)); };
+     }},
+    {"statistics", "mean_strided", [](double n) { return n; },
+     [](int n) -> Op {
+       Matrix m = randomMatrix(n, 2, 1);
+       return [m] { consume(Statistics::calculateMean(m.colView(1))); };
+     }},
+    {"statistics", "variance", [](double n) { return 4 * n; },
+     [](int n) -> Op {
+       vector<double> v = randomVector(n, 1);
+       return [v] { consume(Statistics::calculateVariance(v)); };
+     }},
+    {"statistics", "std_dev", [](double n) { return 4 * n; },
+     [](int n) -> Op {
+       vector<double> v = randomVector(n, 1);
+       return [v] { consume(Statistics::calculateStandardDeviation(v)); };
+     }},
+    {"statistics", "median", noFlops,
+     [](int n) -> Op {
+       vector<double> v = randomVector(n, 1);
+       return [v] { consume(Statistics::calculateMedian(v)); };
+     }},
+    {"statistics", "quantile", noFlops,
+     [](int n) -> Op {
+       vector<double> v = randomVector(n, 1);
+       return [v] { consume(Statistics::calculateQuantile(v, 0.9)); };
+     }},
+    {"statistics", "column_statistics", [](double n) { return 4 * n; },
+     [](int n) -> Op {
+       Matrix m = randomMatrix(max(1, n / 16), 16, 1);
+       return [m] {
+         consume(Statistics::columnStatistics(m)[0].getVariance());
+       };
+     }},
+    {"statistics", "running_add", [](double n) { return 4 * n; },
+     [](int n) -> Op {
+       vector<double> v = randomVector(n, 1);
+       return [v] {
+         RunningStatistics stats;
+         stats.add(v);
+         consume(stats.getVariance());
+       };
+     }},
+    {"statistics", "running_merge", noFlops,
+     [](int n) -> Op {
+       vector<double> v = randomVector(n, 1);
+       RunningStatistics a, b;
+       a.add(v.data(), v.size() / 2);
+       b.add(v.data() + v.size() / 2, v.size() - v.size() / 2);
+       return [a, b] {
+         RunningStatistics merged = a;
+         merged.merge(b);
+         consume(merged.getVariance());
+       };
+     }},
+    {"statistics", "sketch_add", noFlops,
+     [](int n) -> Op {
+       vector<double> v = randomVector(n, 1);
+       return [v] {
+         QuantileSketch sketch;
+         sketch.add(v);
+         consume(sketch.quantile(0.5));
+       };
+     }},
+    {"statistics", "sketch_quantile", noFlops,
+     [](int n) -> Op {
+       QuantileSketch sketch;
+       sketch.add(randomVector(n, 1));
+       sketch.quantile(0.5); // compress once up front
+       return [sketch] { consume(sketch.quantile(0.99)); };
+     }},
+};
+
+struct SuiteResult {
+  const SuiteCase *op;
+  int size;
+  long long reps;
+  double nsPerOp;
+  double gflops; // 0 when the case has no flop count
+  double allocsPerOp;
+  double bytesPerOp;
+};
+
+static SuiteResult runCase(const SuiteCase &c, int size, int warmup,
+                           double minSeconds) {
+  Op op = c.setup(size);
+  for (int i = 0; i < warmup; i++)
+    op();
+  const long long allocs0 = allocationCount.load();
+  const long long bytes0 = allocatedBytes.load();
+  long long reps = 0;
+  double elapsed = 0.0;
+  Clock::time_point start = Clock::now();
+  do {
+    op();
+    reps++;
+    elapsed = chrono::duration<double>(Clock::now() - start).count();
+  } while (elapsed < minSeconds || reps < 3);
+  SuiteResult r;
+  r.op = &c;
+  r.size = size;
+  r.reps = reps;
+  r.nsPerOp = elapsed / reps * 1e9;
+  r.gflops = c.flops(size) / r.nsPerOp;
+  r.allocsPerOp = double(allocationCount.load() - allocs0) / reps;
+  r.bytesPerOp = double(allocatedBytes.load() - bytes0) / reps;
+  return r;
+}
+
+static bool parseSizes(const string &text, vector<int> &sizes) {
+  sizes.clear();
+  stringstream in(text);
+  string item;
+  while (getline(in, item, ',')) {
+    char *end = nullptr;
+    long value = strtol(item.c_str(), &end, 10);
+    if (item.empty() || *end != '\0' || value < 1 || value > 1 << 28)
+      return false;
+    sizes.push_back(static_cast<int>(value));
+  }
+  return !sizes.empty();
+}
+
+static void printTable(const vector<SuiteResult> &results) {
+  cout << left << setw(12) << "group" << setw(26) << "operation" << right
+       << setw(9) << "size" << setw(10) << "reps" << setw(15) << "ns/op"
+       << setw(10) << "GFLOP/s" << setw(11) << "allocs/op" << setw(14)
+       << "bytes/op" << "\n";
+  for (const SuiteResult &r : results) {
+    cout << left << setw(12) << r.op->group << setw(26) << r.op->name
+         << right << setw(9) << r.size << setw(10) << r.reps << setw(15)
+         << fixed << setprecision(1) << r.nsPerOp << setw(10)
+         << setprecision(2);
+    if (r.gflops > 0.0)
+      cout << r.gflops;
+    else
+      cout << "-";
+    cout << setw(11) << setprecision(1) << r.allocsPerOp << setw(14)
+         << setprecision(0) << r.bytesPerOp << "\n";
+  }
+}
+
+static void printCsv(const vector<SuiteResult> &results) {
+  cout << "group,operation,size,reps,ns_per_op,gflops,allocs_per_op,"
+          "bytes_per_op\n";
+  cout << setprecision(6);
+  for (const SuiteResult &r : results) {
+    cout << r.op->group << ',' << r.op->name << ',' << r.size << ','
+         << r.reps << ',' << r.nsPerOp << ',';
+    if (r.gflops > 0.0)
+      cout << r.gflops;
+    cout << ',' << r.allocsPerOp << ',' << r.bytesPerOp << "\n";
+  }
+}
+
+static void printJson(const vector<SuiteResult> &results) {
+  cout << setprecision(6);
+  cout << "{\n  \"kernel\": \"" << gemmKernelName() << "\",\n"
+       << "  \"threads\": " << ThreadPool::instance().getThreadCount()
+       << ",\n  \"results\": [";
+  for (size_t i = 0; i < results.size(); i++) {
+    const SuiteResult &r = results[i];
+    cout << (i == 0 ? "\n" : ",\n") << "    {\"group\": \"" << r.op->group
+         << "\", \"operation\": \"" << r.op->name << "\", \"size\": "
+         << r.size << ", \"reps\": " << r.reps << ", \"ns_per_op\": "
+         << r.nsPerOp << ", \"gflops\": ";
+    if (r.gflops > 0.0)
+      cout << r.gflops;
+    else
+      cout << "null";
+    cout << ", \"allocs_per_op\": " << r.allocsPerOp
+         << ", \"bytes_per_op\": " << r.bytesPerOp << "}";
+  }
+  cout << "\n  ]\n}\n";
+}
+
+static int runSuite(int argc, char **argv) {
+  string format = "table";
+  string filter;
+  vector<int> sizes = {16, 64, 256};
+  vector<int> lengths = {1000, 100000, 1000000};
+  double minSeconds = 0.2;
+  int warmup = 2;
+  for (int i = 2; i < argc; i++) {
+    string arg = argv[i];
+    if (i + 1 >= argc) {
+      cerr << "Missing value for " << arg << "\n";
+      return 1;
+    }
+    string value = argv[++i];
+    if (arg == "--format" &&
+        (value == "table" || value == "csv" || value == "json")) {
+      format = value;
+    } else if (arg == "--sizes" && parseSizes(value, sizes)) {
+    } else if (arg == "--lengths" && parseSizes(value, lengths)) {
+    } else if (arg == "--min-time" && atof(value.c_str()) > 0.0) {
+      minSeconds = atof(value.c_str());
+    } else if (arg == "--warmup" && atoi(value.c_str()) >= 0) {
+      warmup = atoi(value.c_str());
+    } else if (arg == "--filter") {
+      filter = value;
+    } else {
+      cerr << "Invalid option: " << arg << " " << value << "\n";
+      return 1;
+    }
+  }
+
+  vector<SuiteResult> results;
+  for (const SuiteCase &c : SUITE) {
+    if (!filter.empty() && string(c.name).find(filter) == string::npos)
+      continue;
+    const bool matrix = string(c.group) == "matrix";
+    for (int size : matrix ? sizes : lengths) {
+      results.push_back(runCase(c, size, warmup, minSeconds));
+      if (format == "table")
+        cerr << "." << flush; // progress; results go to stdout
+    }
+  }
+  if (format == "table") {
+    cerr << "\n";
+    cout << "GEMM kernel: " << gemmKernelName()
+         << ", threads: " << ThreadPool::instance().getThreadCount() << "\n";
+    printTable(results);
+  } else if (format == "csv") {
+    printCsv(results);
+  } else {
+    printJson(results);
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  string which = argc > 1 ? argv[1] : "gemm";
+  if (which == "gemm") {
+    benchGemm();
+  } else if (which == "batch") {
+    benchBatch();
+  } else if (which == "quantile") {
+    benchQuantile();
+  } else if (which == "sparse") {
+    benchSparse();
+  } else if (which == "pool") {
+    return stressPool(argc > 2 ? atoi(argv[2]) : 300) ? 0 : 1;
+  } else if (which == "suite") {
+    return runSuite(argc, argv);
+  } else {
+    cerr << "Unknown benchmark: " << which << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,171 @@
+// Load generator for the matrix server (main --serve).
+//
+// Build: make loadgen (the binary is build/loadgen)
+// Run:   ./loadgen [--socket /tmp/matrix-server.sock] [--clients 4]
+//                  [--requests 10000] [--depth 8] [--op mul] [--size 8]
+//
+// Each client opens its own connection and keeps `depth` requests in
+// flight until it has sent `requests` of them. Operands are random
+// size x size matrices (vectors of size^2 elements for statistics
+// operations). Latency is measured per request from send to response.
+
+#include "MatrixServer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+typedef chrono::steady_clock Clock;
+
+struct LoadOptions {
+  string socket = DEFAULT_SERVER_SOCKET;
+  int clients = 4;
+  int requests = 10000; // per client
+  int depth = 8;
+  BatchOp op = BatchOp::Multiply;
+  int size = 8;
+};
+
+struct ClientResult {
+  vector<double> latencies; // microseconds
+  int errors = 0;
+  string failure;
+};
+
+static Matrix randomOperand(int rows, int cols, unsigned seed) {
+  mt19937 gen(seed);
+  normal_distribution<double> dist(0.0, 1.0);
+  Matrix m(rows, cols);
+  for (int i = 0; i < rows; i++)
+    for (int j = 0; j < cols; j++)
+      m.rowPtr(i)[j] = dist(gen);
+  // Diagonally dominant, so det/inv/solve stay well conditioned
+  for (int i = 0; i < min(rows, cols); i++)
+    m.rowPtr(i)[i] += cols;
+  return m;
+}
+
+static void runClient(const LoadOptions &options, int index,
+                      ClientResult &result) {
+  try {
+    const bool vectorOp = options.op == BatchOp::Mean ||
+                          options.op == BatchOp::Variance ||
+                          options.op == BatchOp::StdDev ||
+                          options.op == BatchOp::Median ||
+                          options.op == BatchOp::Quantile;
+    vector<Matrix> args;
+    for (int a = 0; a < batchOpArity(options.op); a++) {
+      const unsigned seed = static_cast<unsigned>(index * 8 + a);
+      args.push_back(vectorOp
+                         ? randomOperand(1, options.size * options.size, seed)
+                         : randomOperand(options.size, options.size, seed));
+    }
+    const double param = options.op == BatchOp::Quantile ? 0.9 : 0.0;
+
+    MatrixClient client(options.socket);
+    vector<Clock::time_point> sent(options.requests);
+    result.latencies.reserve(options.requests);
+    int next = 0;
+    while (next < min(options.depth, options.requests)) {
+      sent[next] = Clock::now();
+      client.send(next, options.op, args, param);
+      next++;
+    }
+    for (int done = 0; done < options.requests; done++) {
+      MatrixResponse response = client.receive();
+      const Clock::time_point now = Clock::now();
+      result.latencies.push_back(
+          chrono::duration<double, micro>(now - sent[response.id]).count());
+      if (!response.ok)
+        result.errors++;
+      if (next < options.requests) {
+        sent[next] = Clock::now();
+        client.send(next, options.op, args, param);
+        next++;
+      }
+    }
+  } catch (const exception &e) {
+    result.failure = e.what();
+  }
+}
+
+static double percentile(const vector<double> &sorted, double q) {
+  if (sorted.empty())
+    return 0.0;
+  const size_t index = static_cast<size_t>(q * (sorted.size() - 1) + 0.5);
+  return sorted[min(index, sorted.size() - 1)];
+}
+
+static bool parseOptions(int argc, char **argv, LoadOptions &options) {
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (i + 1 >= argc) {
+      cerr << "Missing value for " << arg << "\n";
+      return false;
+    }
+    string value = argv[++i];
+    if (arg == "--socket") {
+      options.socket = value;
+    } else if (arg == "--clients" && atoi(value.c_str()) > 0) {
+      options.clients = atoi(value.c_str());
+    } else if (arg == "--requests" && atoi(value.c_str()) > 0) {
+      options.requests = atoi(value.c_str());
+    } else if (arg == "--depth" && atoi(value.c_str()) > 0) {
+      options.depth = atoi(value.c_str());
+    } else if (arg == "--op" && parseBatchOp(value, options.op)) {
+    } else if (arg == "--size" && atoi(value.c_str()) > 0) {
+      options.size = atoi(value.c_str());
+    } else {
+      cerr << "Invalid option: " << arg << " " << value << "\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  LoadOptions options;
+  if (!parseOptions(argc, argv, options))
+    return 1;
+
+  vector<ClientResult> results(options.clients);
+  vector<thread> threads;
+  const Clock::time_point start = Clock::now();
+  for (int c = 0; c < options.clients; c++)
+    threads.emplace_back(runClient, cref(options), c, ref(results[c]));
+  for (thread &t : threads)
+    t.join();
+  const double seconds =
+      chrono::duration<double>(Clock::now() - start).count();
+
+  vector<double> latencies;
+  int errors = 0;
+  for (const ClientResult &r : results) {
+    if (!r.failure.empty()) {
+      cerr << "error " << r.failure << "\n";
+      return 2;
+    }
+    latencies.insert(latencies.end(), r.latencies.begin(),
+                     r.latencies.end());
+    errors += r.errors;
+  }
+  sort(latencies.begin(), latencies.end());
+
+  cout << "op " << batchOpName(options.op) << "  size " << options.size
+       << "  clients " << options.clients << "  depth " << options.depth
+       << "\n";
+  cout << fixed << setprecision(1);
+  cout << "requests    " << latencies.size() << " in " << seconds << " s ("
+       << errors << " errors)\n";
+  cout << "throughput  " << latencies.size() / seconds << " req/s\n";
+  cout << "latency us  p50 " << percentile(latencies, 0.50) << "  p99 "
+       << percentile(latencies, 0.99) << "  max "
+       << (latencies.empty() ? 0.0 : latencies.back()) << "\n";
+  return errors == 0 ? 0 : 1;
+}
@@ -1,5 +1,9 @@
+#include "BatchMode.h"
 #include "Matrix.h"
+#include "MatrixServer.h"
 #include "Statistics.h"
+#include <csignal>
+#include <fstream>
 #include <iostream>
 #include <limits>
 #include <vector>
@@ -31,11 +35,12 @@ void calculateDeterminant();
 void calculateInverse();
 void transposeMatrix();
 void calculateTrace();
+void solveLinearSystem();
 
 void printHeader() {
   cout << BOLD << CYAN;
   cout << "\n=============================================\n";
-  cout << "   LINEAR ALGEBRA CALCULATOR (MAX 5x5)\n";
+  cout << "        LINEAR ALGEBRA CALCULATOR\n";
   cout << "       High Precision Decimal Results\n";
   cout << "=============================================\n" << RESET;
 }
@@ -48,22 +53,22 @@ void printLinearAlgebraMenu() {
   cout << GREEN << "4.  " << RESET << "Inverse\n";
   cout << GREEN << "5.  " << RESET << "Transpose\n";
   cout << GREEN << "6.  " << RESET << "Trace\n";
+  cout << GREEN << "7.  " << RESET << "Solve Linear System (AX = B)\n";
   cout << GREEN << "0.  " << RESET << "Back to Main Menu\n";
   cout << BOLD << YELLOW << "============================\n" << RESET;
 }
 
 Matrix inputMatrix(const string &name) {
   int rows, cols;
-  cout << CYAN << "\nEnter number of rows for " << name << " (max " << MAX_SIZE
-       << "): " << RESET;
+  cout << CYAN << "\nEnter number of rows for " << name << ": " << RESET;
   cin >> rows;
-  cout << CYAN << "Enter number of columns for " << name << " (max " << MAX_SIZE
-       << "): " << RESET;
+  cout << CYAN << "Enter number of columns for " << name << ": " << RESET;
   cin >> cols;
 
-  if (rows < 1 || rows > MAX_SIZE || cols < 1 || cols > MAX_SIZE) {
-    throw std::invalid_argument("Matrix dimensions must be between 1 and " +
-                                std::to_string(MAX_SIZE));
+  if (cin.fail() || rows < 1 || cols < 1) {
+    cin.clear();
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    throw std::invalid_argument("Matrix dimensions must be positive");
   }
 
   Matrix m(rows, cols);
@@ -133,8 +138,11 @@ void linearAlgebraMenu() {
     case 6:
       calculateTrace();
       break;
+    case 7:
+      solveLinearSystem();
+      break;
     default:
-      cout << RED << "Invalid option! Please select 0-6." << RESET << endl;
+      cout << RED << "Invalid option! Please select 0-7." << RESET << endl;
     }
 
     waitForEnter();
@@ -177,19 +185,19 @@ void statisticalMenu() {
         int type;
         cin >> type;
 
-        vector<double> data;
+        VectorView data;
         if (type == 1) {
           int r;
           cout << CYAN << "Enter row index (1-" << M.getRows()
                << "): " << RESET;
           cin >> r;
-          data = M.getRowVector(r - 1);
+          data = M.rowView(r - 1);
         } else if (type == 2) {
           int c;
           cout << CYAN << "Enter column index (1-" << M.getCols()
                << "): " << RESET;
           cin >> c;
-          data = M.getColVector(c - 1);
+          data = M.colView(c - 1);
         } else {
           cout << RED << "Invalid choice!" << RESET << endl;
           waitForEnter();
@@ -197,7 +205,7 @@ void statisticalMenu() {
         }
 
         cout << GREEN << "\nSelected Data: " << RESET;
-        for (size_t i = 0; i < data.size(); i++) {
+        for (int i = 0; i < data.size(); i++) {
           cout << fixed << setprecision(4) << data[i]
                << (i == data.size() - 1 ? "" : ", ");
         }
@@ -244,7 +252,7 @@ void matrixAddSubtract() {
   try {
     Matrix A = inputMatrix("Matrix A");
     Matrix B = inputMatrix("Matrix B");
-    Matrix C = (choice == 1) ? (A + B) : (A - B);
+    Matrix C = (choice == 1) ? Matrix(A + B) : Matrix(A - B);
     cout << GREEN << "\nMatrix A:" << RESET;
     A.display();
     cout << GREEN << "Matrix B:" << RESET;
@@ -302,6 +310,19 @@ void calculateInverse() {
   }
 }
 
+void solveLinearSystem() {
+  cout << BOLD << MAGENTA << "\n=== Solve AX = B ===\n" << RESET;
+  try {
+    Matrix A = inputMatrix("Matrix A");
+    Matrix B = inputMatrix("Right-hand side B");
+    Matrix X = Matrix::solve(A, B);
+    cout << GREEN << "\nSolution X:" << RESET;
+    X.display();
+  } catch (const exception &e) {
+    cout << RED << "Error: " << e.what() << RESET << endl;
+  }
+}
+
 void transposeMatrix() {
   cout << BOLD << MAGENTA << "\n=== Matrix Transpose ===\n" << RESET;
   try {
@@ -330,7 +351,53 @@ void calculateTrace() {
   }
 }
 
-int main() {
+// main --batch [file|-]: run a script of jobs without the menus (see
+// BatchMode.h). Exit status is 0 when every job succeeds, 1 otherwise.
+int runBatchMain(int argc, char **argv) {
+  ios::sync_with_stdio(false);
+  string path = argc > 2 ? argv[2] : "-";
+  if (path == "-")
+    return runBatch(cin, cout) == 0 ? 0 : 1;
+  ifstream file(path);
+  if (!file) {
+    cerr << "error cannot open " << path << endl;
+    return 2;
+  }
+  return runBatch(file, cout) == 0 ? 0 : 1;
+}
+
+static MatrixServer *activeServer = nullptr;
+
+static void stopServer(int) {
+  if (activeServer != nullptr)
+    activeServer->stop();
+}
+
+// main --serve [socket]: answer MatrixClient requests (see MatrixServer.h)
+// until interrupted
+int runServeMain(int argc, char **argv) {
+  string path = argc > 2 ? argv[2] : DEFAULT_SERVER_SOCKET;
+  try {
+    MatrixServer server(path);
+    activeServer = &server;
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    cerr << "serving on " << path << endl;
+    server.run();
+    activeServer = nullptr;
+  } catch (const exception &e) {
+    cerr << "error " << e.what() << endl;
+    return 2;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && string(argv[1]) == "--batch")
+    return runBatchMain(argc, argv);
+  if (argc > 1 && string(argv[1]) == "--serve")
+    return runServeMain(argc, argv);
+
   int choice;
 
   while (true) {